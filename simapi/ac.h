@@ -2,6 +2,7 @@
 #define _AC_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "../include/acdata.h"
 
 #define AC_EXE "acs.exe"
@@ -14,6 +15,9 @@
 #define AC_GRAPHIC_FILE "acpmf_graphics"
 #define AC_CREWCHIEF_FILE "acpmf_crewchief"
 
+// the crewchief page has room for this many vehicles
+#define AC_MAX_VEHICLES 64
+
 typedef struct
 {
     bool has_physics;
@@ -32,6 +36,30 @@ typedef struct
     struct SPageFileStatic ac_static;
     struct SPageFileGraphic ac_graphic;
     struct SPageFileCrewChief ac_crewchief;
+    // packetId of the physics and graphics copies, the mapper only redoes a
+    // section when its page was copied again
+    bool physics_copied;
+    bool graphic_copied;
+    bool physics_fresh;
+    bool graphic_fresh;
+    int physics_packet;
+    int graphic_packet;
+    // the static page has no packetId, it is hashed again when the graphics
+    // page shows a new status or session or its packetId starts over, and at
+    // least every SIMSNAPSHOT_STATIC_NS, and copied when that differs
+    bool static_copied;
+    bool static_fresh;
+    int static_status;
+    int static_session;
+    int static_packet;
+    uint64_t static_hashed; // CLOCK_MONOTONIC ns
+    uint64_t static_hash;
+    // the crewchief page has neither a packetId nor a write marker, it is copied
+    // when the graphics page moves, or without a graphics page when the cars in
+    // use differ from the last copy, and compared again after the copy so a copy
+    // the plugin wrote into is taken once more
+    bool crewchief_copied;
+    bool crewchief_fresh;
     char car[32];
     char driver[32];
     char track[32];
@@ -8,9 +8,12 @@
 #include <signal.h>
 #include <errno.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/types.h>
 
 #include "getpid.h"
+#include "simapi.h"
 
 static int isMatch(const char* possibleMatch, const char* checkAgainst)
 {
@@ -279,6 +282,251 @@ int IsProcessRunning(char* pidstring)
     return ret;
 }
 
+// pids seen to match nothing are remembered with their comm, so on the next
+// run only comm is read for them, cmdline is skipped
+#define PROCSCAN_CACHE_SLOTS 4096
+#define PROCSCAN_COMM_SIZE 64
+#define PROCSCAN_CMDLINE_SIZE 4096
+
+typedef struct
+{
+    int pid;
+    char comm[16];
+}
+ProcScanEntry;
+
+struct ProcScan
+{
+    int count;
+    char* names[PROCSCAN_MAX_NAMES];
+    size_t lens[PROCSCAN_MAX_NAMES];
+    int pids[PROCSCAN_MAX_NAMES];
+    // names starting with each (lowercased) byte, one bit per name
+    uint64_t first[256];
+
+    ProcScanEntry* cache;
+    ProcScanEntry* next;
+};
+
+ProcScan* procscan_create(void)
+{
+    ProcScan* ps = calloc(1, sizeof(ProcScan));
+    if (ps == NULL)
+    {
+        return NULL;
+    }
+    ps->cache = calloc(PROCSCAN_CACHE_SLOTS, sizeof(ProcScanEntry));
+    ps->next = calloc(PROCSCAN_CACHE_SLOTS, sizeof(ProcScanEntry));
+    if (ps->cache == NULL || ps->next == NULL)
+    {
+        procscan_free(ps);
+        return NULL;
+    }
+    return ps;
+}
+
+void procscan_free(ProcScan* ps)
+{
+    if (ps == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < ps->count; i++)
+    {
+        free(ps->names[i]);
+    }
+    free(ps->cache);
+    free(ps->next);
+    free(ps);
+}
+
+int procscan_add(ProcScan* ps, const char* name)
+{
+    if (name == NULL || name[0] == '\0')
+    {
+        return -1;
+    }
+    if (ps->count == PROCSCAN_MAX_NAMES)
+    {
+        // first is one bit per name, the table cannot grow past 64
+        char msg[128];
+        snprintf(msg, sizeof(msg), "procscan is full at %i names, not looking for %s", PROCSCAN_MAX_NAMES, name);
+        simapi_log(SIMAPI_LOGLEVEL_INFO, msg);
+        return -1;
+    }
+
+    int index = ps->count;
+    char* lower = strdup(name);
+    if (lower == NULL)
+    {
+        return -1;
+    }
+    for (char* c = lower; *c != '\0'; c++)
+    {
+        *c = tolower((unsigned char) *c);
+    }
+
+    ps->names[index] = lower;
+    ps->lens[index] = strlen(lower);
+    ps->pids[index] = -1;
+    ps->first[(unsigned char) lower[0]] |= (uint64_t) 1 << index;
+    ps->count++;
+
+    // a pid that matched nothing before might match the new name
+    memset(ps->cache, 0, PROCSCAN_CACHE_SLOTS * sizeof(ProcScanEntry));
+    return index;
+}
+
+int procscan_pid(ProcScan* ps, int index)
+{
+    if (index < 0 || index >= ps->count)
+    {
+        return -1;
+    }
+    return ps->pids[index];
+}
+
+static ProcScanEntry* procscan_slot(ProcScanEntry* table, int pid)
+{
+    unsigned int h = ((unsigned int) pid * 2654435761u) & (PROCSCAN_CACHE_SLOTS - 1);
+    while (table[h].pid != 0 && table[h].pid != pid)
+    {
+        h = (h + 1) & (PROCSCAN_CACHE_SLOTS - 1);
+    }
+    return &table[h];
+}
+
+// reads a small proc file into buf and lowercases it, stopping at the first nul
+static size_t procscan_read(int dirfd, const char* path, char* buf, size_t size)
+{
+    int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return 0;
+    }
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n <= 0)
+    {
+        return 0;
+    }
+
+    size_t len = 0;
+    while (len < (size_t) n && buf[len] != '\0')
+    {
+        buf[len] = tolower((unsigned char) buf[len]);
+        len++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+// one pass over text, records pid for every name found in it
+static int procscan_match(ProcScan* ps, const char* text, size_t len, int pid)
+{
+    int found = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint64_t candidates = ps->first[(unsigned char) text[i]];
+        while (candidates != 0)
+        {
+            int n = __builtin_ctzll(candidates);
+            candidates &= candidates - 1;
+            if (ps->lens[n] <= len - i && memcmp(&text[i], ps->names[n], ps->lens[n]) == 0)
+            {
+                if (ps->pids[n] == -1)
+                {
+                    ps->pids[n] = pid;
+                }
+                found = 1;
+            }
+        }
+    }
+    return found;
+}
+
+int procscan_run(ProcScan* ps)
+{
+    for (int i = 0; i < ps->count; i++)
+    {
+        ps->pids[i] = -1;
+    }
+
+    DIR* dirp = opendir("/proc/");
+    if (dirp == NULL)
+    {
+        return 0;
+    }
+    int procfd = dirfd(dirp);
+
+    memset(ps->next, 0, PROCSCAN_CACHE_SLOTS * sizeof(ProcScanEntry));
+    int cached = 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(dirp)) != NULL)
+    {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9' || check_if_number(entry->d_name) == 0)
+        {
+            continue;
+        }
+
+        int pid = atoi(entry->d_name);
+        // room for any d_name, so the path is never cut short
+        char path[sizeof(entry->d_name) + sizeof("/cmdline")];
+        char comm[PROCSCAN_COMM_SIZE];
+        char cmdline[PROCSCAN_CMDLINE_SIZE];
+
+        snprintf(path, sizeof(path), "%s/comm", entry->d_name);
+        size_t commlen = procscan_read(procfd, path, comm, sizeof(comm));
+        if (commlen == 0)
+        {
+            continue;
+        }
+
+        ProcScanEntry* old = procscan_slot(ps->cache, pid);
+        if (old->pid == pid && strncmp(old->comm, comm, sizeof(old->comm)) == 0)
+        {
+            // same process as last time, it still matches nothing
+            if (cached < PROCSCAN_CACHE_SLOTS / 2)
+            {
+                *procscan_slot(ps->next, pid) = *old;
+                cached++;
+            }
+            continue;
+        }
+
+        int found = procscan_match(ps, comm, commlen, pid);
+        snprintf(path, sizeof(path), "%s/cmdline", entry->d_name);
+        size_t cmdlen = procscan_read(procfd, path, cmdline, sizeof(cmdline));
+        found |= procscan_match(ps, cmdline, cmdlen, pid);
+
+        if (found == 0 && cached < PROCSCAN_CACHE_SLOTS / 2)
+        {
+            ProcScanEntry* e = procscan_slot(ps->next, pid);
+            e->pid = pid;
+            // comm is at most TASK_COMM_LEN, 16 with its newline, comm[] is bigger than that
+            memcpy(e->comm, comm, sizeof(e->comm));
+            cached++;
+        }
+    }
+    closedir(dirp);
+
+    // pids that went away are simply not carried over
+    ProcScanEntry* t = ps->cache;
+    ps->cache = ps->next;
+    ps->next = t;
+
+    int running = 0;
+    for (int i = 0; i < ps->count; i++)
+    {
+        if (ps->pids[i] > 0)
+        {
+            running++;
+        }
+    }
+    return running;
+}
+
 //int main()
 //{
 //    bool b = IsProcessRunning("acs");
@@ -1,3 +1,6 @@
+#ifndef _GETPID_H
+#define _GETPID_H
+
 #include <sys/types.h>
 
 #define MAX_BUF 1024
@@ -8,3 +11,22 @@ int is_pid_running(pid_t pid);
 int IsProcessRunning(char* pidstring);
 
 char* getEnvValueForPid(pid_t pid, const char* envName);
+
+// walks /proc once per procscan_run() and matches every registered name in
+// that single pass, a name matches the same way IsProcessRunning() does,
+// case insensitively anywhere in comm or argv[0]
+#define PROCSCAN_MAX_NAMES 64
+
+typedef struct ProcScan ProcScan;
+
+ProcScan* procscan_create(void);
+void procscan_free(ProcScan* ps);
+// returns the index to pass to procscan_pid(), or -1 if the name is empty or the table is
+// full, which is logged through simapi_log()
+int procscan_add(ProcScan* ps, const char* name);
+// returns how many of the registered names are running
+int procscan_run(ProcScan* ps);
+// first pid matching name index from the last run, or -1
+int procscan_pid(ProcScan* ps, int index);
+
+#endif
@@ -5,6 +5,8 @@
 #include "../simdata.h"
 #include "../simapi.h"
 #include "../simmapper.h"
+#include "../simsnapshot.h"
+#include "../simstrings.h"
 #include "../ac.h"
 
 #include "../../include/acdata.h"
@@ -84,15 +86,10 @@ int acc_get_global_flag(int yellow, int white, int chequered, int green, int red
 }
 
 
-void map_assetto_corsa_data(SimData* simdata, SimMap* simmap, SimulatorEXE simexe)
+// a new physics page, AC writes one every physics step
+static void ac_map_physics(SimData* simdata, ACMap* ac)
 {
-
-    char* a;
-    char* b;
-    char* c;
-    char* d;
-
-    a = simmap->ac.physics_map_addr;
+    char* a = (char*) &ac->ac_physics;
 
     // basic telemetry
     simdata->rpms = *(uint32_t*) (char*) (a + offsetof(struct SPageFilePhysics, rpms));
@@ -199,164 +196,201 @@ void map_assetto_corsa_data(SimData* simdata, SimMap* simmap, SimulatorEXE simex
     simdata->airtemp = *(float*) (char*) (a + offsetof(struct SPageFilePhysics, airTemp));
     simdata->tracktemp = *(float*) (char*) (a + offsetof(struct SPageFilePhysics, roadTemp));
 
-
-    if ( simmap->ac.has_graphic == true )
+    if (ac->has_static == true && ac->ac_static.maxRpm == 0)
     {
-        c = simmap->ac.graphic_map_addr;
-
-        // temporary workaround for beta data from ACEvo and ACRally
-        if(simexe == SIMULATOREXE_ASSETTO_CORSA_EVO || simexe == SIMULATOREXE_ASSETTO_CORSA_RALLY)
+        if(simdata->rpms > 0 && simdata->rpms > simdata->maxrpm)
         {
-            simdata->simstatus = SIMAPI_STATUS_ACTIVEPLAY;
-        }
-        else
-        {
-            simdata->simstatus = *(int*) (char*) (c + offsetof(struct SPageFileGraphic, status));
+            simdata->maxrpm = simdata->rpms;
         }
+    }
+    simdata->turboboost = simdata->turboboostperct * simdata->maxturbo;
+}
 
-        simdata->lap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, completedLaps));
-        simdata->position = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, position));
-        uint32_t lastlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iLastTime));
-        simdata->lastlap = ac_convert_to_simdata_laptime(lastlap);
-        uint32_t bestlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iBestTime));
-        simdata->bestlap = ac_convert_to_simdata_laptime(bestlap);
-        uint32_t currentlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iCurrentTime));
-        simdata->currentlap = ac_convert_to_simdata_laptime(currentlap);
-        //simdata->time = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iCurrentTime));
-        simdata->numlaps = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, numberOfLaps));
-        simdata->session = *(int32_t*) (char*) (c + offsetof(struct SPageFileGraphic, session));
-        simdata->sectorindex = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, currentSectorIndex));
-        simdata->lastsectorinms = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, lastSectorTime));
-        simdata->playerflag = acc_flag_to_simdata_flag(*(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, Flag)));
-
-        int yellow = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalYellow));
-        int white = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalWhite));
-        int chequered = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalChequered));
-        int green = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalGreen));
-        int red = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalRed));
-        simdata->courseflag = acc_get_global_flag( yellow, white, chequered, green, red);
-
-        int strsize = 32;
-        for(int i=0; i<strsize; i++)
-        {
-            simdata->tyrecompound[i] = *(char*) (char*) ((c + offsetof(struct SPageFileGraphic, tyreCompound)) + (sizeof(char16_t) * i));
-        }
-        //simdata->tyrecompound = simmap->ac.compound;
+// a new graphics page, once a rendered frame
+static void ac_map_graphic(SimData* simdata, ACMap* ac, SimulatorEXE simexe)
+{
+    char* c = (char*) &ac->ac_graphic;
 
-        //float timeleft = *(float*) (char*) (c + offsetof(struct SPageFileGraphic, sessionTimeLeft));
-        //if (timeleft < 0)
-        //    simdata->timeleft = 0;
-        //else
-        //    simdata->timeleft = droundint(timeleft);
+    // temporary workaround for beta data from ACEvo and ACRally
+    if(simexe == SIMULATOREXE_ASSETTO_CORSA_EVO || simexe == SIMULATOREXE_ASSETTO_CORSA_RALLY)
+    {
+        simdata->simstatus = SIMAPI_STATUS_ACTIVEPLAY;
+    }
+    else
+    {
+        simdata->simstatus = *(int*) (char*) (c + offsetof(struct SPageFileGraphic, status));
     }
 
-    simdata->maxturbo = 0;
-    if (simmap->ac.has_static == true )
+    simdata->lap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, completedLaps));
+    simdata->position = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, position));
+    uint32_t lastlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iLastTime));
+    simdata->lastlap = ac_convert_to_simdata_laptime(lastlap);
+    uint32_t bestlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iBestTime));
+    simdata->bestlap = ac_convert_to_simdata_laptime(bestlap);
+    uint32_t currentlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iCurrentTime));
+    simdata->currentlap = ac_convert_to_simdata_laptime(currentlap);
+    //simdata->time = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iCurrentTime));
+    simdata->numlaps = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, numberOfLaps));
+    simdata->session = *(int32_t*) (char*) (c + offsetof(struct SPageFileGraphic, session));
+    simdata->sectorindex = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, currentSectorIndex));
+    simdata->lastsectorinms = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, lastSectorTime));
+    simdata->playerflag = acc_flag_to_simdata_flag(*(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, Flag)));
+
+    int yellow = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalYellow));
+    int white = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalWhite));
+    int chequered = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalChequered));
+    int green = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalGreen));
+    int red = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, GlobalRed));
+    simdata->courseflag = acc_get_global_flag( yellow, white, chequered, green, red);
+
+    int strsize = 32;
+    for(int i=0; i<strsize; i++)
     {
-        b = simmap->ac.static_map_addr;
-        uint32_t maxrpm = *(uint32_t*) (char*) (b + offsetof(struct SPageFileStatic, maxRpm));
-        if(maxrpm > 0)
-        {
-            simdata->maxrpm = maxrpm;
-        }
-        else
-        {
-            if(simdata->rpms > 0 && simdata->rpms > simdata->maxrpm)
-            {
-                simdata->maxrpm = simdata->rpms;
-            }
-        }
-        simdata->maxturbo = *(float*) (char*) (b + offsetof(struct SPageFileStatic, MaxTurboBoost));
+        simdata->tyrecompound[i] = *(char*) (char*) ((c + offsetof(struct SPageFileGraphic, tyreCompound)) + (sizeof(char16_t) * i));
+    }
+    //simdata->tyrecompound = simmap->ac.compound;
 
-        simdata->tyrediameter[0] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 0));
-        simdata->tyrediameter[1] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 1));
-        simdata->tyrediameter[2] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 2));
-        simdata->tyrediameter[3] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 3));
-        for(int j=0; j<4; j++)
-        {
-            simdata->tyrediameter[j] = simdata->tyrediameter[j] * 2;
-        }
+    //float timeleft = *(float*) (char*) (c + offsetof(struct SPageFileGraphic, sessionTimeLeft));
+    //if (timeleft < 0)
+    //    simdata->timeleft = 0;
+    //else
+    //    simdata->timeleft = droundint(timeleft);
+}
 
-        int strsize = 32;
-        for(int i=0; i<strsize; i++)
-        {
-            simdata->car[i] = *(char*) (char*) ((b + offsetof(struct SPageFileStatic, carModel)) + (sizeof(char16_t) * i));
-            simdata->track[i] = *(char*) (char*) ((b + offsetof(struct SPageFileStatic, track)) + (sizeof(char16_t) * i));
-            simdata->driver[i] = *(char*) (char*) ((b + offsetof(struct SPageFileStatic, playerName)) + (sizeof(char16_t) * i));
-        }
+// the static page, only when its contents changed
+static void ac_map_static(SimData* simdata, ACMap* ac)
+{
+    char* b = (char*) &ac->ac_static;
 
+    uint32_t maxrpm = *(uint32_t*) (char*) (b + offsetof(struct SPageFileStatic, maxRpm));
+    if(maxrpm > 0)
+    {
+        simdata->maxrpm = maxrpm;
     }
-    simdata->turboboost = simdata->turboboostperct * simdata->maxturbo;
+    simdata->maxturbo = *(float*) (char*) (b + offsetof(struct SPageFileStatic, MaxTurboBoost));
 
-    // realtime telemetry
-    if (simmap->ac.has_crewchief == true && simdata->simexe != SIMULATOREXE_ASSETTO_CORSA_COMPETIZIONE )
+    simdata->tyrediameter[0] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 0));
+    simdata->tyrediameter[1] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 1));
+    simdata->tyrediameter[2] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 2));
+    simdata->tyrediameter[3] = *(float*) (char*) (b + offsetof(struct SPageFileStatic, tyreRadius) + (sizeof(float) * 3));
+    for(int j=0; j<4; j++)
     {
-        d = simmap->ac.crewchief_map_addr;
-
-        simdata->worldposx = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, x)));
-        simdata->worldposz = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, y)));
-        simdata->worldposy = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, z)));
-        double heading = simdata->heading;
-        double player_rotation = heading;
-
-
-        float player_spline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, spLineLength)));
-        float track_spline = *(float*) (char*) (b + offsetof(struct SPageFileStatic, TrackSPlineLength));
-        simdata->playerspline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, spLineLength)));
-        simdata->trackspline = *(float*) (char*) (b + offsetof(struct SPageFileStatic, TrackSPlineLength));
-        simdata->trackdistancearound = spLineLengthToDistanceRoundTrack(track_spline, player_spline);
-        int track_samples = track_spline * 4;
-        simdata->tracksamples = track_samples;
-        simdata->playertrackpos = (int) simdata->trackdistancearound;
-
-        simdata->numcars = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, numVehicles));
-        int numcars = simdata->numcars;
-        if (numcars > MAXCARS)
-        {
-            numcars = MAXCARS;
-        }
+        simdata->tyrediameter[j] = simdata->tyrediameter[j] * 2;
+    }
 
-        int strsize = 32;
-        for(int i=0; i<numcars; i++)
-        {
-            simdata->cars[i].lap = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, lapCount)));
-            simdata->cars[i].pos = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, carLeaderboardPosition)));
-            uint32_t lastlap = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, lastLapTimeMS)));
-            uint32_t bestlap = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, bestLapMS)));
-            simdata->cars[i].bestlap = ac_convert_to_simdata_laptime(bestlap);
-            simdata->cars[i].lastlap = ac_convert_to_simdata_laptime(lastlap);
-            //uint32_t currentlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iCurrentTime));
-            //simdata->currentlap = ac_convert_to_simdata_laptime(currentlap);
-            simdata->cars[i].inpitlane = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, isCarInPitline)));
-            simdata->cars[i].inpit = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, isCarInPit)));
-
-            int strsize = 32;
-            for(int k=0; k<strsize; k++)
-            {
-                simdata->cars[i].driver[k] = *(char*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, driverName)) + (sizeof(char) * k));
-                simdata->cars[i].car[k] = *(char*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, carModel)) + (sizeof(char) * k));
-            }
-            simdata->cars[i].speed = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, speedMS)));
-
-            //simdata->cars[i].carspline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, spLineLength)));
-            float spline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, spLineLength)));
-            simdata->cars[i].trackpos = spLineLengthToDistanceRoundTrack(track_spline, spline);
-            //simdata->cars[i].trackpos = (int) track_spline * spline;
-            simdata->cars[i].xpos = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, x)));
-            simdata->cars[i].zpos = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, y)));
-            simdata->cars[i].ypos = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, z)));
-        }
-        SetProximityData(simdata, numcars, -1);
+    int strsize = 32;
+    for(int i=0; i<strsize; i++)
+    {
+        simdata->car[i] = *(char*) (char*) ((b + offsetof(struct SPageFileStatic, carModel)) + (sizeof(char16_t) * i));
+        simdata->track[i] = *(char*) (char*) ((b + offsetof(struct SPageFileStatic, track)) + (sizeof(char16_t) * i));
+        simdata->driver[i] = *(char*) (char*) ((b + offsetof(struct SPageFileStatic, playerName)) + (sizeof(char16_t) * i));
+    }
+}
+
+// from the snapshot of the crewchief page, only when it was copied again
+static void ac_map_crewchief(SimData* simdata, SimMap* simmap)
+{
+    ACMap* ac = &simmap->ac;
+    char* b = (char*) &ac->ac_static;
+    char* d = (char*) &ac->ac_crewchief;
+
+    simdata->worldposx = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, x)));
+    simdata->worldposz = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, y)));
+    simdata->worldposy = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, z)));
+    double heading = simdata->heading;
+    double player_rotation = heading;
+
+
+    float player_spline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, spLineLength)));
+    float track_spline = *(float*) (char*) (b + offsetof(struct SPageFileStatic, TrackSPlineLength));
+    simdata->playerspline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, spLineLength)));
+    simdata->trackspline = *(float*) (char*) (b + offsetof(struct SPageFileStatic, TrackSPlineLength));
+    simdata->trackdistancearound = spLineLengthToDistanceRoundTrack(track_spline, player_spline);
+    int track_samples = track_spline * 4;
+    simdata->tracksamples = track_samples;
+    simdata->playertrackpos = (int) simdata->trackdistancearound;
+
+    int numcars = *(int*) (char*) (d + offsetof(struct SPageFileCrewChief, numVehicles));
+    if (numcars < 0)
+    {
+        numcars = 0;
+    }
+    if (numcars > AC_MAX_VEHICLES)
+    {
+        numcars = AC_MAX_VEHICLES;
+    }
+    simdata->numcars = numcars;
+
+    int strsize = 32;
+    for(int i=0; i<numcars; i++)
+    {
+        simdata->cars[i].lap = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, lapCount)));
+        simdata->cars[i].pos = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, carLeaderboardPosition)));
+        uint32_t lastlap = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, lastLapTimeMS)));
+        uint32_t bestlap = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, bestLapMS)));
+        simdata->cars[i].bestlap = ac_convert_to_simdata_laptime(bestlap);
+        simdata->cars[i].lastlap = ac_convert_to_simdata_laptime(lastlap);
+        //uint32_t currentlap = *(uint32_t*) (char*) (c + offsetof(struct SPageFileGraphic, iCurrentTime));
+        //simdata->currentlap = ac_convert_to_simdata_laptime(currentlap);
+        simdata->cars[i].inpitlane = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, isCarInPitline)));
+        simdata->cars[i].inpit = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, isCarInPit)));
+
+        simstrings_copy(simdata->cars[i].driver, (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, driverName))), 32);
+        simstrings_copy(simdata->cars[i].car, (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, carModel))), 32);
+        simdata->cars[i].speed = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, speedMS)));
+
+        //simdata->cars[i].carspline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, spLineLength)));
+        float spline = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, spLineLength)));
+        simdata->cars[i].trackpos = spLineLengthToDistanceRoundTrack(track_spline, spline);
+        //simdata->cars[i].trackpos = (int) track_spline * spline;
+        simdata->cars[i].xpos = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, x)));
+        simdata->cars[i].zpos = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, y)));
+        simdata->cars[i].ypos = *(float*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * i) + offsetof(acsVehicleInfo, worldPosition) + offsetof(acsVec3, z)));
+    }
+    simapi_set_proximity_data(simdata, simmap, numcars, 0, -1);
+
+    simdata->playerlaps = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, lapCount)));
+    simdata->lapisvalid = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, currentLapInvalid)));
+    simdata->lapisvalid = !simdata->lapisvalid;
+
+    int currentlapinticks = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, currentLapTimeMS)));
+    int lastlapinticks = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, lastLapTimeMS)));
+    simdata->currentlapinseconds = currentlapinticks * 100000;
+    simdata->lastlapinseconds = lastlapinticks * 100000;
+}
+
+void map_assetto_corsa_data(SimData* simdata, SimMap* simmap, SimulatorEXE simexe)
+{
+    ACMap* ac = &simmap->ac;
+    simsnapshot_ac(simmap, simdata->simexe != SIMULATOREXE_ASSETTO_CORSA_COMPETIZIONE);
+
+    // the physics, graphics and static pages only fill the player's fields ahead of cars
+    if (ac->has_static == false)
+    {
+        simdata->maxturbo = 0;
+    }
+    else if (ac->static_fresh == true)
+    {
+        ac_map_static(simdata, ac);
+    }
 
-        simdata->playerlaps = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, lapCount)));
-        simdata->lapisvalid = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, currentLapInvalid)));
-        simdata->lapisvalid = !simdata->lapisvalid;
+    if (ac->physics_fresh == true)
+    {
+        ac_map_physics(simdata, ac);
+    }
 
-        int currentlapinticks = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, currentLapTimeMS)));
-        int lastlapinticks = *(uint32_t*) (char*) (d + offsetof(struct SPageFileCrewChief, vehicle) + ((sizeof(acsVehicleInfo) * 0) + offsetof(acsVehicleInfo, lastLapTimeMS)));
-        simdata->currentlapinseconds = currentlapinticks * 100000;
-        simdata->lastlapinseconds = lastlapinticks * 100000;
+    if (ac->has_graphic == true && ac->graphic_fresh == true)
+    {
+        ac_map_graphic(simdata, ac, simexe);
     }
 
     simdata->altitude = 1;
+    simmap_dirty(simmap, 0, offsetof(SimData, cars));
+
+    // realtime telemetry
+    if (ac->has_crewchief == true && simdata->simexe != SIMULATOREXE_ASSETTO_CORSA_COMPETIZIONE && ac->crewchief_fresh == true)
+    {
+        ac_map_crewchief(simdata, simmap);
+        simmap_dirty(simmap, 0, offsetof(SimData, simapi));
+    }
 }
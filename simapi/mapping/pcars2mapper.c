@@ -6,6 +6,7 @@
 #include "../simdata.h"
 #include "../simapi.h"
 #include "../simmapper.h"
+#include "../simsnapshot.h"
 #include "../pcars2.h"
 
 #include "../../include/pcars2data.h"
@@ -91,7 +92,8 @@ void map_project_cars2_data(SimData* simdata, SimMap* simmap, bool udp, char* ba
     if(udp == false)
     {
 
-        a = simmap->pcars2.telemetry_map_addr;
+        simsnapshot_pcars2(simmap);
+        a = (char*) &simmap->pcars2.pcars2_telemetry;
         // basic telemetry
         uint8_t s = *(uint8_t*) (char*) (a + offsetof(struct pcars2APIStruct, mGameState));
         simdata->simstatus = 0;
@@ -286,7 +288,7 @@ void map_project_cars2_data(SimData* simdata, SimMap* simmap, bool udp, char* ba
         simdata->worldposy = *(float*) (char*) (a + offsetof(struct pcars2APIStruct, mParticipantInfo) + offsetof(ParticipantInfo, mWorldPosition) + (sizeof(float) * 2));
 
 
-        SetProximityData(simdata, numcars, 1);
+        simapi_set_proximity_data(simdata, simmap, numcars, 0, 1);
         return;
     }
     else
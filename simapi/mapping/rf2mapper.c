@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <limits.h>
 #include <math.h>
 
@@ -7,6 +8,8 @@
 #include "../simdata.h"
 #include "../simapi.h"
 #include "../simmapper.h"
+#include "../simsnapshot.h"
+#include "../simstrings.h"
 #include "../rf2.h"
 
 #include "../../include/rf2data.h"
@@ -62,53 +65,223 @@ static int rf2_flag_to_simdata_flag(int rf2_flag)
 }
 
 
-void map_rfactor2_data(SimData* simdata, SimMap* simmap)
+// copies the mIDs of a freshly snapshotted buffer, true if any differ from last time
+static bool rf2_join_ids(int* ids, int* vehicles, const char* first, size_t stride, int n)
 {
+    if (n < 0)
+    {
+        n = 0;
+    }
+    if (n > RF2_MAX_VEHICLES)
+    {
+        n = RF2_MAX_VEHICLES;
+    }
 
-    char* a;
-    char* b;
+    bool changed = n != *vehicles;
+    for (int i = 0; i < n; i++)
+    {
+        int id = *(int*) (first + (stride * i));
+        changed |= id != ids[i];
+        ids[i] = id;
+    }
+    *vehicles = n;
+    return changed;
+}
 
-    a = simmap->rf2.telemetry_map_addr;
+// a hash of the telemetry mIDs, twice the vehicles so probes stay short
+#define RF2_JOIN_HASH (RF2_MAX_VEHICLES * 2)
+
+static unsigned int rf2_join_hash(int id)
+{
+    return (((uint32_t) id * 2654435761u) >> 25) & (RF2_JOIN_HASH - 1);
+}
+
+static void rf2_join_build(RF2Join* join)
+{
+    int keys[RF2_JOIN_HASH];
+    int8_t slots[RF2_JOIN_HASH];
+    memset(slots, -1, sizeof(slots));
+
+    for (int t = 0; t < join->telemetry_vehicles; t++)
+    {
+        unsigned int h = rf2_join_hash(join->telemetry_ids[t]);
+        while (slots[h] != -1)
+        {
+            h = (h + 1) & (RF2_JOIN_HASH - 1);
+        }
+        keys[h] = join->telemetry_ids[t];
+        slots[h] = t;
+    }
+
+    for (int s = 0; s < join->scoring_vehicles; s++)
+    {
+        unsigned int h = rf2_join_hash(join->scoring_ids[s]);
+        while (slots[h] != -1 && keys[h] != join->scoring_ids[s])
+        {
+            h = (h + 1) & (RF2_JOIN_HASH - 1);
+        }
+        join->telemetry_slot[s] = slots[h];
+    }
+}
+
+// everything that comes from rF2Scoring, which the plugin only refreshes at
+// ~5Hz, so this runs only when a new copy of it was taken
+static void rf2_map_scoring(SimData* simdata, RF2Map* rf2)
+{
+    char* b = (char*) &rf2->rf2_scoring;
 
     // Find the player vehicle.
 
     int sco = 0; // Index of player vehicle in scoring.
-    int veh = 0; // Index of player vehicle in telemetry.
+    rf2->player_sco = -1;
+    int num_scored_vehicles = rf2->join.scoring_vehicles;
+    for (int i = 0; i < num_scored_vehicles; i++)
+    {
+        signed char control = *(signed char*)(char*)(b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mControl));
+        if (control == 0)
+        {
+            sco = i;
+            rf2->player_sco = i;
+            break;
+        }
+    }
+
+    uint8_t s = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mGamePhase));
+    // TODO: will need to track something additional since on session over a value of 8 will still be present when
+    // the user has returned to the menu
+    if (s > 2)
+    {
+        simdata->simstatus = 2;
+    }
+    else
+    {
+        simdata->simstatus = 0;
+    }
+    s = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mGamePhase));
+    switch (s)
+    {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 9:
+            simdata->session = 0;
+        case 5:
+        case 6:
+        case 7:
+        case 8:
+            simdata->session = 1;
+        case 10:
+        case 11:
+        case 12:
+        case 13:
+            simdata->session = 2;
+        default:
+            simdata->session = 0;
+    }
+
+    simdata->airtemp = *(double*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mAmbientTemp));
+    simdata->tracktemp = *(double*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mTrackTemp));
 
-    if (simmap->rf2.has_scoring == true)
+    double trackdist = *(double*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mLapDist));
+    double pos = *(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mLapDist));
+    if(pos < 0)
     {
-        b = simmap->rf2.scoring_map_addr;
+        pos = (-1 * pos) + .5;
+    }
+    simdata->tracksamples = ceil(trackdist * 4);
+    simdata->playerspline = (pos/trackdist);
+
+    simdata->position = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mPlace));
+
+    simdata->lastlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mLastLapTime)));
+    simdata->bestlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mBestLapTime)));
+    simdata->currentlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mTimeIntoLap)));
 
-        int id = -1;
-        int num_scored_vehicles = *(int*)(char*)(b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mNumVehicles));
-        for (int i = 0; i < num_scored_vehicles; i++)
+
+    simdata->numlaps = *(uint32_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mMaxLaps));
+    if(simdata->numlaps == INT_MAX)
+    {
+        simdata->numlaps = 0;
+    }
+    //simdata->session
+    simdata->sectorindex = *(uint32_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mSector));
+    //simdata->lastsectorinms
+    simdata->playerflag = rf2_flag_to_simdata_flag(*(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mFlag)));
+    simdata->courseflag = rf2_phase_to_simdata_flag(*(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mGamePhase)));
+
+    // Car, the track comes from telemetry
+    simstrings_copy(simdata->car, (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mVehicleName)), 64);
+    //simstrings_copy(simdata->track, (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mTrackName)), 64);
+
+    // Driver
+    simstrings_copy(simdata->driver, (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mDriverName)), 32);
+    simdata->driver[32] = '\0';
+
+    // a row per scoring slot, the telemetry pass fills in the rest of each car
+    simdata->numcars = num_scored_vehicles;
+    for(int i=0; i<num_scored_vehicles; i++)
+    {
+        simdata->cars[i].pos = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mPlace));
+        uint8_t pitstate = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mPitState));
+        uint8_t garagestall = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mInGarageStall));
+        simdata->cars[i].ingarage = false;
+        simdata->cars[i].inpitstopped = false;
+        simdata->cars[i].inpitentrance = false;
+        simdata->cars[i].inpitexit = false;
+        if(pitstate == 2)
         {
-            signed char control = *(signed char*)(char*)(b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mControl));
-            if (control == 0)
-            {
-                sco = i;
-                id = *(int*)(char*)(b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mID));
-                break;
-            }
+            simdata->cars[i].inpitentrance = true;
         }
-
-        if (id != -1)
+        if(pitstate == 3)
+        {
+            simdata->cars[i].inpitstopped = true;
+        }
+        if(pitstate == 4)
         {
-            int num_telemetry_vehicles = *(int*)(char*)(a + offsetof(struct rF2Telemetry, mNumVehicles));
-            for (int i = 0; i < num_telemetry_vehicles; i++)
-            {
-                int slot_id = *(int*)(char*)(a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * i) + offsetof(rF2VehicleTelemetry, mID));
-                if (id == slot_id)
-                {
-                    veh = i;
-                    break;
-                }
-            }
+            simdata->cars[i].inpitexit = true;
         }
+        if(pitstate >= 2)
+        {
+            simdata->cars[i].inpit = true;
+        }
+        if(pitstate == 2 || pitstate == 4)
+        {
+            simdata->cars[i].inpitlane = true;
+        }
+        if(garagestall > 0)
+        {
+            simdata->cars[i].ingarage = true;
+        }
+        if(simdata->cars[i].ingarage == true)
+        {
+            simdata->cars[i].inpit = true;
+        }
+
+        simdata->cars[i].lastlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mLastLapTime)));
+        simdata->cars[i].bestlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mBestLapTime)));
+
+
+        simstrings_copy(simdata->cars[i].driver, (char*) (b + offsetof(struct rF2Scoring, mVehicles) + offsetof(rF2VehicleScoring, mDriverName) + (sizeof(rF2VehicleScoring) * i)), 32);
+        simstrings_copy(simdata->cars[i].car, (char*) (b + offsetof(struct rF2Scoring, mVehicles) + offsetof(rF2VehicleScoring, mVehicleName) + (sizeof(rF2VehicleScoring) * i)), 64);
     }
+}
 
-    // basic telemetry
+// rF2Telemetry, every time the plugin wrote it, the scoring values in
+// simdata are left as the last scoring pass mapped them
+static void rf2_map_telemetry(SimData* simdata, SimMap* simmap, bool has_scoring)
+{
+    RF2Map* rf2 = &simmap->rf2;
+    char* a = (char*) &rf2->rf2_telemetry;
 
+    int veh = 0; // Index of player vehicle in telemetry.
+    if (has_scoring == true && rf2->player_sco != -1 && rf2->join.telemetry_slot[rf2->player_sco] != -1)
+    {
+        veh = rf2->join.telemetry_slot[rf2->player_sco];
+    }
+
+    // basic telemetry
 
     simdata->velocity = abs(droundint(3.6 * (*(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + ((sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mLocalVel)) + (sizeof(double) * 2)))));
     simdata->rpms = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + ((sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mEngineRPM)));
@@ -142,13 +315,14 @@ void map_rfactor2_data(SimData* simdata, SimMap* simmap)
     simdata->tyreRPS[2] = -1 * *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mRotation) + (sizeof(TelemWheelV01) * 2)));
     simdata->tyreRPS[3] = -1 * *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mRotation) + (sizeof(TelemWheelV01) * 3)));
 
-    simdata->Xvelocity = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mLocalVel) + (sizeof(double) * 0 ));
-    simdata->Zvelocity = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mLocalVel) + (sizeof(double) * 1 ));
-    simdata->Yvelocity = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mLocalVel) + (sizeof(double) * 2 ));
+    // the player's slot, like every other field here, slot 0 is whichever car telemetry lists first
+    simdata->Xvelocity = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mLocalVel) + (sizeof(double) * 0 ));
+    simdata->Zvelocity = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mLocalVel) + (sizeof(double) * 1 ));
+    simdata->Yvelocity = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mLocalVel) + (sizeof(double) * 2 ));
 
-    rF2Vec3 orix = *(rF2Vec3*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mOri) + (sizeof(rF2Vec3) * 0 ));
-    rF2Vec3 oriy = *(rF2Vec3*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mOri) + (sizeof(rF2Vec3) * 1 ));
-    rF2Vec3 oriz = *(rF2Vec3*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mOri) + (sizeof(rF2Vec3) * 2 ));
+    rF2Vec3 orix = *(rF2Vec3*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mOri) + (sizeof(rF2Vec3) * 0 ));
+    rF2Vec3 oriy = *(rF2Vec3*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mOri) + (sizeof(rF2Vec3) * 1 ));
+    rF2Vec3 oriz = *(rF2Vec3*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mOri) + (sizeof(rF2Vec3) * 2 ));
 
     simdata->worldXvelocity = (orix.x * simdata->Xvelocity) + (orix.z * simdata->Yvelocity) + (orix.y * simdata->Zvelocity);
     simdata->worldYvelocity = (oriz.x * simdata->Xvelocity) + (oriz.z * simdata->Yvelocity) + (oriz.y * simdata->Zvelocity);
@@ -158,231 +332,111 @@ void map_rfactor2_data(SimData* simdata, SimMap* simmap)
     simdata->Yvelocity = -1 * simdata->Yvelocity;
     simdata->Zvelocity = -1 * simdata->Zvelocity;
 
-    //advanced ui
-    if (simmap->rf2.has_scoring == true )
+    if (has_scoring == false)
     {
-        uint8_t s = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mGamePhase));
-        // TODO: will need to track something additional since on session over a value of 8 will still be present when
-        // the user has returned to the menu
-        if (s > 2)
-        {
-            simdata->simstatus = 2;
-        }
-        else
-        {
-            simdata->simstatus = 0;
-        }
-        s = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mGamePhase));
-        switch (s)
-        {
-            case 0:
-            case 1:
-            case 2:
-            case 3:
-            case 4:
-            case 9:
-                simdata->session = 0;
-            case 5:
-            case 6:
-            case 7:
-            case 8:
-                simdata->session = 1;
-            case 10:
-            case 11:
-            case 12:
-            case 13:
-                simdata->session = 2;
-            default:
-                simdata->session = 0;
-        }
-
-
-        simdata->tyrewear[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 0)));
-        simdata->tyrewear[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 1)));
-        simdata->tyrewear[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 2)));
-        simdata->tyrewear[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 3)));
-
-        simdata->tyretemp[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 0)));
-        simdata->tyretemp[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 1)));
-        simdata->tyretemp[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 2)));
-        simdata->tyretemp[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 3)));
-
-        for(int k = 0; k<4; k++)
-        {
-            simdata->tyretemp[k] = simdata->tyretemp[k] - 273.15;
-        }
-
-        simdata->braketemp[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 0)));
-        simdata->braketemp[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 1)));
-        simdata->braketemp[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 2)));
-        simdata->braketemp[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 3)));
+        return;
+    }
 
-        simdata->tyrepressure[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 0)));
-        simdata->tyrepressure[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 1)));
-        simdata->tyrepressure[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 2)));
-        simdata->tyrepressure[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 3)));
+    simdata->tyrewear[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 0)));
+    simdata->tyrewear[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 1)));
+    simdata->tyrewear[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 2)));
+    simdata->tyrewear[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mWear) + (sizeof(TelemWheelV01) * 3)));
 
-        simdata->airtemp = *(double*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mAmbientTemp));
-        simdata->tracktemp = *(double*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mTrackTemp));
+    simdata->tyretemp[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 0)));
+    simdata->tyretemp[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 1)));
+    simdata->tyretemp[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 2)));
+    simdata->tyretemp[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mTireCarcassTemperature) + (sizeof(TelemWheelV01) * 3)));
 
-        double trackdist = *(double*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mLapDist));
-        double pos = *(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mLapDist));
-        if(pos < 0)
-        {
-            pos = (-1 * pos) + .5;
-        }
-        simdata->tracksamples = ceil(trackdist * 4);
-        simdata->playerspline = (pos/trackdist);
+    for(int k = 0; k<4; k++)
+    {
+        simdata->tyretemp[k] = simdata->tyretemp[k] - 273.15;
+    }
 
-        simdata->lap = *(uint32_t*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mLapNumber));
-        simdata->lap++;
-        simdata->position = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mPlace));
+    simdata->braketemp[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 0)));
+    simdata->braketemp[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 1)));
+    simdata->braketemp[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 2)));
+    simdata->braketemp[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mBrakeTemp) + (sizeof(TelemWheelV01) * 3)));
 
-        simdata->lastlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mLastLapTime)));
-        simdata->bestlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mBestLapTime)));
-        simdata->currentlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mTimeIntoLap)));
+    simdata->tyrepressure[0] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 0)));
+    simdata->tyrepressure[1] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 1)));
+    simdata->tyrepressure[2] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 2)));
+    simdata->tyrepressure[3] = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mWheel) + (offsetof(TelemWheelV01, mPressure) + (sizeof(TelemWheelV01) * 3)));
 
+    simdata->lap = *(uint32_t*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mLapNumber));
+    simdata->lap++;
+    simdata->sessiontime = rf2_convert_to_simdata_laptime(*(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mElapsedTime)));
 
-        simdata->numlaps = *(uint32_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mMaxLaps));
-        if(simdata->numlaps == INT_MAX)
-        {
-            simdata->numlaps = 0;
-        }
-        //simdata->session
-        simdata->sectorindex = *(uint32_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mSector));
-        //simdata->lastsectorinms
-        simdata->playerflag = rf2_flag_to_simdata_flag(*(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mFlag)));
-        simdata->courseflag = rf2_phase_to_simdata_flag(*(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mGamePhase)));
-        double z = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mElapsedTime));
-        simdata->sessiontime = rf2_convert_to_simdata_laptime(*(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + offsetof(rF2VehicleTelemetry, mElapsedTime)));
-
-        // Car and Track
-        size_t actsize = 0;
-        size_t actsize2 = 0;
-        int strsize = 64;
-        for(int i=0; i<strsize; i++)
-        {
-            simdata->car[i] = *(char*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mVehicleName) + (sizeof(char)*i));
-            //simdata->track[i] = *(char*) (char*) (b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mTrackName) + (sizeof(char)*i));
-            simdata->track[i] = *(char*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mTrackName) + (sizeof(char)*i));
-            if(simdata->car[i] != '\0')
-            {
-                actsize++;
-            }
-            if(simdata->track[i] != '\0')
-            {
-                actsize2++;
-            }
-        }
+    // Track
+    simstrings_copy(simdata->track, (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mTrackName)), 64);
 
-        // Driver
-        strsize = 32;
-        actsize = 0;
-        for(int i=0; i<strsize; i++)
-        {
-            simdata->driver[i] = *(char*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * sco) + offsetof(rF2VehicleScoring, mDriverName) + (sizeof(char)*i));
-            if(simdata->driver[i] != '\0')
-            {
-                actsize++;
-            }
-        }
-        simdata->driver[32] = '\0';
+    //Tyre Compound
+    simstrings_copy(simdata->tyrecompound, (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mRearTireCompoundName)), 18);
 
-        //Tyre Compound
-        strsize = 18;
-        actsize = 0;
-        for(int i=0; i<strsize; i++)
+    // rows follow scoring, a car that telemetry does not have yet is nowhere,
+    // NaN keeps it off the radar and out of the neighbour lists
+    int numcars = rf2->join.scoring_vehicles;
+    for(int i=0; i<numcars; i++)
+    {
+        int t = rf2->join.telemetry_slot[i];
+        if (t == -1)
         {
-            simdata->tyrecompound[i] = *(char*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mRearTireCompoundName) + (sizeof(char)*i));
-            if(simdata->tyrecompound[i] != '\0')
-            {
-                actsize++;
-            }
+            simdata->cars[i].lap = 0;
+            simdata->cars[i].xpos = NAN;
+            simdata->cars[i].zpos = NAN;
+            simdata->cars[i].ypos = NAN;
+            continue;
         }
+        simdata->cars[i].lap = *(uint32_t*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * t) + offsetof(rF2VehicleTelemetry, mLapNumber));
+        simdata->cars[i].xpos = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * t) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 0 ));
+        simdata->cars[i].zpos = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * t) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 1 ));
+        simdata->cars[i].ypos = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * t) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 2 ));
+    }
 
-        simdata->numcars = *(uint32_t*) (char*) (a + offsetof(struct rF2Telemetry, mNumVehicles));
-        int numcars = simdata->numcars;
-        if (numcars > MAXCARS)
-        {
-            numcars = MAXCARS;
-        }
-        for(int i=0; i<numcars; i++)
-        {
 
-            simdata->cars[i].lap = *(uint32_t*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * i) + offsetof(rF2VehicleTelemetry, mLapNumber));
-            simdata->cars[i].pos = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mPlace));
-            uint8_t pitstate = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mPitState));
-            uint8_t garagestall = *(uint8_t*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mInGarageStall));
-            simdata->cars[i].ingarage = false;
-            simdata->cars[i].inpitstopped = false;
-            simdata->cars[i].inpitentrance = false;
-            simdata->cars[i].inpitexit = false;
-            if(pitstate == 2)
-            {
-                simdata->cars[i].inpitentrance = true;
-            }
-            if(pitstate == 3)
-            {
-                simdata->cars[i].inpitstopped = true;
-            }
-            if(pitstate == 4)
-            {
-                simdata->cars[i].inpitexit = true;
-            }
-            if(pitstate >= 2)
-            {
-                simdata->cars[i].inpit = true;
-            }
-            if(pitstate == 2 || pitstate == 4)
-            {
-                simdata->cars[i].inpitlane = true;
-            }
-            if(garagestall > 0)
-            {
-                simdata->cars[i].ingarage = true;
-            }
-            if(simdata->cars[i].ingarage == true)
-            {
-                simdata->cars[i].inpit = true;
-            }
-
-            simdata->cars[i].lastlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mLastLapTime)));
-            simdata->cars[i].bestlap = rf2_convert_to_simdata_laptime(*(double*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * i) + offsetof(rF2VehicleScoring, mBestLapTime)));
-
-
-            strsize = 32;
-            actsize = 0;
-            for(int k=0; k<strsize; k++)
-            {
-                simdata->cars[i].driver[k] = *(char*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + offsetof(rF2VehicleScoring, mDriverName) + (sizeof(rF2VehicleScoring) * i) + (sizeof(char)*k));
-                if(simdata->cars[i].driver[k] != '\0')
-                {
-                    actsize++;
-                }
-            }
-
-            actsize = 0;
-            strsize = 64;
-            for(int k=0; k<strsize; k++)
-            {
-                simdata->cars[i].car[k] = *(char*) (char*) (b + offsetof(struct rF2Scoring, mVehicles) + offsetof(rF2VehicleScoring, mVehicleName) + (sizeof(rF2VehicleScoring) * i) + (sizeof(char)*k));
-                if(simdata->cars[i].driver[k] != '\0')
-                {
-                    actsize++;
-                }
-            }
-
-            simdata->cars[i].xpos = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * i) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 0 ));
-            simdata->cars[i].zpos = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * i) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 1 ));
-            simdata->cars[i].ypos = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * i) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 2 ));
-        }
+    simdata->worldposx = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 0 ));
+    simdata->worldposz = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 1 ));
+    simdata->worldposy = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 2 ));
 
+    simapi_set_proximity_data(simdata, simmap, numcars, rf2->player_sco, 1);
+}
 
-        simdata->worldposx = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 0 ));
-        simdata->worldposz = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 1 ));
-        simdata->worldposy = *(double*) (char*) (a + offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * veh) + offsetof(rF2VehicleTelemetry, mPos) + (sizeof(double) * 2 ));
+void map_rfactor2_data(SimData* simdata, SimMap* simmap)
+{
+    RF2Map* rf2 = &simmap->rf2;
+    simsnapshot_rf2(simmap);
 
-        SetProximityData(simdata, numcars, 1);
+    bool rejoin = false;
+    if (rf2->telemetry_fresh == true)
+    {
+        rejoin |= rf2_join_ids(rf2->join.telemetry_ids, &rf2->join.telemetry_vehicles,
+                               (char*) &rf2->rf2_telemetry.mVehicles[0].mID, sizeof(rF2VehicleTelemetry), rf2->rf2_telemetry.mNumVehicles);
+    }
+    if (rf2->has_scoring == false)
+    {
+        rf2->join.scoring_vehicles = 0;
+    }
+    else if (rf2->scoring_fresh == true)
+    {
+        rejoin |= rf2_join_ids(rf2->join.scoring_ids, &rf2->join.scoring_vehicles,
+                               (char*) &rf2->rf2_scoring.mVehicles[0].mID, sizeof(rF2VehicleScoring), rf2->rf2_scoring.mScoringInfo.mNumVehicles);
+    }
+    if (rejoin == true)
+    {
+        rf2_join_build(&rf2->join);
     }
 
+    // scoring fills the player's fields and the cars, telemetry the cars' positions and the radar too
+    bool scored = rf2->has_scoring == true && rf2->scoring_fresh == true;
+    if (scored == true)
+    {
+        rf2_map_scoring(simdata, rf2);
+        simmap_dirty(simmap, 0, offsetof(SimData, pd));
+    }
+    // new scoring can reorder the rows or move the player, the last telemetry
+    // copy is joined again so positions stay with their cars until the next one
+    if (rf2->telemetry_fresh == true || (scored == true && rf2->join.telemetry_vehicles > 0))
+    {
+        rf2_map_telemetry(simdata, simmap, rf2->has_scoring);
+        simmap_dirty(simmap, 0, offsetof(SimData, simapi));
+    }
 }
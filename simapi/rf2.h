@@ -2,6 +2,7 @@
 #define _RF2_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "../include/rf2data.h"
 
 #define RFACTOR2_EXE "rFactor2.exe"
@@ -10,6 +11,21 @@
 #define RF2_TELEMETRY_FILE "$rFactor2SMMP_Telemetry$"
 #define RF2_SCORING_FILE "$rFactor2SMMP_Scoring$"
 
+// the plugin's buffers have room for this many vehicles
+#define RF2_MAX_VEHICLES 64
+
+// telemetry and scoring list the same vehicles in their own order, matched up
+// by mID, the join is only built again when either list of mIDs changes
+typedef struct
+{
+    int telemetry_vehicles;
+    int scoring_vehicles;
+    int telemetry_ids[RF2_MAX_VEHICLES];
+    int scoring_ids[RF2_MAX_VEHICLES];
+    int8_t telemetry_slot[RF2_MAX_VEHICLES]; // by scoring slot, -1 when telemetry has no such mID
+}
+RF2Join;
+
 typedef struct
 {
     bool has_telemetry;
@@ -20,6 +36,17 @@ typedef struct
     int fd_scoring;
     struct rF2Telemetry rf2_telemetry;
     struct rF2Scoring rf2_scoring;
+    // mVersionUpdateEnd of the copies above, scoring only moves at ~5Hz so
+    // the mapper redoes each half only when its buffer was copied again
+    bool telemetry_copied;
+    bool scoring_copied;
+    bool telemetry_fresh;
+    bool scoring_fresh;
+    int telemetry_version;
+    int scoring_version;
+    RF2Join join;
+    // the player's scoring slot as the last scoring pass found it, -1 for none
+    int player_sco;
     char car[64];
     char driver[33];
     char track[64];
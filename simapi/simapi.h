@@ -19,6 +19,9 @@ typedef enum
 }
 SIMAPI_LOGLEVEL;
 
+// hands message to the function set for its level, if any
+void simapi_log(SIMAPI_LOGLEVEL sll, char* message);
+
 typedef enum
 {
     SIMULATORAPI_SIMAPI_TEST       = 0,
@@ -66,6 +69,7 @@ typedef enum
     SIMAPI_ERROR_UNKNOWN       = 1,
     SIMAPI_ERROR_INVALID_SIM   = 2,
     SIMAPI_ERROR_NODATA        = 3,
+    SIMAPI_ERROR_BUSY          = 4,
 }
 SimAPIError;
 
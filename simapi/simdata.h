@@ -194,4 +194,250 @@ typedef struct //SimData
 } SimData;
 
 #pragma pack(pop)
+
+#define SIMAPI_CACHELINE 64
+// SimData is split into page sized regions, each with its own generation
+#define SIMAPI_REGION_SIZE 4096
+#define SIMAPI_REGIONS ((sizeof(SimData) + SIMAPI_REGION_SIZE - 1) / SIMAPI_REGION_SIZE)
+
+// SIMAPI.DAT is SimData followed by this block on its own cache line, so
+// applications that only map sizeof(SimData) keep working unchanged.
+// sequence is odd while simd is writing a frame, see simapi_read_simdata()
+typedef struct //SimDataSync
+{
+    uint32_t sequence;
+    uint32_t poked; // bit per region simd --poke wrote into SIMAPI.DAT, simd publishes them whole next frame
+    uint64_t frames; // incremented once per published frame
+    uint32_t regions[SIMAPI_REGIONS]; // low 32 bits of frames when the region last changed
+    // CLOCK_MONOTONIC ns for the frame in the file, 0 where unknown
+    uint64_t sourcetime; // simd saw the source change, or the kernel received the datagram
+    uint64_t mappedtime; // simdatamap() finished
+    uint64_t publishedtime; // written to this file
+} SimDataSync;
+
+#define SIMAPI_SYNC_OFFSET ((sizeof(SimData) + SIMAPI_CACHELINE - 1) & ~((size_t) SIMAPI_CACHELINE - 1))
+#define SIMAPI_MEM_SIZE (SIMAPI_SYNC_OFFSET + sizeof(SimDataSync))
+
+// SIMAPI.HOT, the per frame physics a motion rig or haptics needs, published on every frame
+typedef struct //SimDataHot
+{
+    uint64_t mtick;
+
+    uint32_t simstatus;
+    uint32_t velocity;
+    uint32_t rpms;
+    uint32_t gear;
+    uint32_t maxrpm;
+    uint32_t idlerpm;
+    uint32_t maxgears;
+    uint32_t altitude;
+
+    double Xvelocity;
+    double Yvelocity;
+    double Zvelocity;
+
+    double worldXvelocity;
+    double worldYvelocity;
+    double worldZvelocity;
+
+    double gas;
+    double brake;
+    double fuel;
+    double fuelcapacity;
+    double clutch;
+    double steer;
+    double handbrake;
+
+    double turboboost;
+    double turboboostperct;
+    double maxturbo;
+
+    double abs;
+    double brakebias;
+    double tyreRPS[4];
+    double tyrediameter[4];
+
+    double heading;
+    double pitch;
+    double roll;
+    double worldposx;
+    double worldposy;
+    double worldposz;
+
+    double braketemp[4];
+    double tyrewear[4];
+    double tyretemp[4];
+    double tyrepressure[4];
+
+    double tyrecontact0[4];
+    double tyrecontact1[4];
+    double tyrecontact2[4];
+
+    double suspension[4];
+    double suspvelocity[4];
+
+    double playerspline;
+
+    uint64_t simexe;
+    uint8_t simapi;
+    bool simon;
+    uint8_t simapiversion;
+    char gearc[3];
+} SimDataHot;
+
+// SIMAPI.COLD, session, standings and names, published at a lower rate
+typedef struct //SimDataCold
+{
+    uint64_t mtick;
+
+    uint32_t lap;
+    uint32_t position;
+    uint32_t numlaps;
+    uint32_t playerlaps;
+    uint32_t numcars;
+
+    double distance;
+    double airdensity;
+    double airtemp;
+    double tracktemp;
+    double trackdistancearound;
+    double trackspline;
+    uint32_t playertrackpos;
+    uint32_t tracksamples;
+
+    LapTime lastlap;
+    LapTime bestlap;
+    LapTime currentlap;
+    uint32_t currentlapinseconds;
+    uint32_t lastlapinseconds;
+    uint32_t time;
+    LapTime sessiontime;
+    uint8_t session;
+    uint8_t sectorindex;
+    double sector1time;
+    double sector2time;
+    uint32_t lastsectorinms;
+    uint8_t courseflag;
+    uint8_t playerflag;
+
+    bool lapisvalid;
+
+    char car[128];
+    char track[128];
+    char driver[128];
+    char tyrecompound[128];
+
+    CarData cars[MAXCARS];
+    ProximityData pd[PROXCARS];
+} SimDataCold;
+
+// SimDataCars pitflags, one bit for each of CarData's pit bools
+#define SIMAPI_CAR_INPIT         0x01
+#define SIMAPI_CAR_INPITLANE     0x02
+#define SIMAPI_CAR_INGARAGE      0x04
+#define SIMAPI_CAR_INPITENTRANCE 0x08
+#define SIMAPI_CAR_INPITEXIT     0x10
+#define SIMAPI_CAR_INPITSTOPPED  0x20
+
+// the nearest cars listed for each car in SimDataCars
+#define SIMAPI_CAR_NEIGHBOURS    16
+
+// the SimDataCars string table, every distinct name once, cut to its first 63
+// characters, names alike in those share one string
+#define SIMAPI_STRINGS           320
+#define SIMAPI_STRING_SIZE       64
+
+// SIMAPI.CARS, SimData's cars as one array per field, published every frame
+// each array starts on a cache line, names are ids into the string table at
+// the end, so a pass over positions never pulls a name into the cache
+typedef struct //SimDataCars
+{
+    uint64_t mtick;
+    uint32_t numcars;
+    uint32_t namesgeneration; // moves whenever the string table changes
+    double neighbourradius; // metres, 0 when simd lists no neighbours
+    uint16_t trackid; // the player's names, ids into strings
+    uint16_t playercarid;
+    uint16_t playerdriverid;
+    uint16_t compoundid;
+    uint8_t reserved[32];
+
+    double xpos[MAXCARS];
+    double ypos[MAXCARS];
+    double zpos[MAXCARS];
+    double carspline[MAXCARS];
+    double speed[MAXCARS];
+    uint32_t pos[MAXCARS];
+    uint32_t lap[MAXCARS];
+    uint32_t trackpos[MAXCARS];
+    uint8_t pitflags[MAXCARS]; // SIMAPI_CAR_*
+    uint16_t driverid[MAXCARS]; // ids into strings, 0 is ""
+    uint16_t carid[MAXCARS];
+
+    // the cars within neighbourradius of each car, nearest first, cars in the
+    // garage are in no list and have none
+    uint8_t neighbours[MAXCARS];
+    uint8_t neighbour[MAXCARS][SIMAPI_CAR_NEIGHBOURS];
+
+    // an id keeps its string for as long as a car or the player uses it
+    char strings[SIMAPI_STRINGS][SIMAPI_STRING_SIZE];
+} SimDataCars;
+
+// all segment files end with a SimDataSync on its own cache line, like SIMAPI.DAT
+#define SIMAPI_SEGMENT_SYNC_OFFSET(type) ((sizeof(type) + SIMAPI_CACHELINE - 1) & ~((size_t) SIMAPI_CACHELINE - 1))
+#define SIMAPI_SEGMENT_MEM_SIZE(type) (SIMAPI_SEGMENT_SYNC_OFFSET(type) + sizeof(SimDataSync))
+
+// SIMAPI.RING, the last slots frames of the physics an effect differentiates, oldest overwritten first
+// a SimRingHeader, a SimDataSync on the next cache line, then the slots from SIMAPI_RING_SLOTS_OFFSET
+#define SIMAPI_RING_VERSION 1
+#define SIMAPI_RING_DEFAULT_SLOTS 512
+
+typedef struct //SimRingHeader
+{
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slotsize; // sizeof(SimRingFrame)
+    uint32_t reserved;
+} SimRingHeader;
+
+typedef struct //SimRingFrame
+{
+    uint64_t frame; // numbered from 1, 0 while simd is writing the slot
+    uint64_t sourcetime; // CLOCK_MONOTONIC ns the frame left the sim, or was published when that is unknown
+    uint64_t mtick;
+
+    uint32_t simstatus;
+    uint32_t velocity;
+    uint32_t rpms;
+    uint32_t gear;
+
+    double Xvelocity;
+    double Yvelocity;
+    double Zvelocity;
+
+    double worldXvelocity;
+    double worldYvelocity;
+    double worldZvelocity;
+
+    double heading;
+    double pitch;
+    double roll;
+    double worldposx;
+    double worldposy;
+    double worldposz;
+
+    double gas;
+    double brake;
+    double clutch;
+    double steer;
+
+    double tyreRPS[4];
+    double suspension[4];
+    double suspvelocity[4];
+} SimRingFrame;
+
+#define SIMAPI_RING_SYNC_OFFSET SIMAPI_CACHELINE
+#define SIMAPI_RING_SLOTS_OFFSET ((SIMAPI_RING_SYNC_OFFSET + sizeof(SimDataSync) + SIMAPI_CACHELINE - 1) & ~((size_t) SIMAPI_CACHELINE - 1))
+#define SIMAPI_RING_MEM_SIZE(slots) (SIMAPI_RING_SLOTS_OFFSET + (size_t) (slots) * sizeof(SimRingFrame))
+
 #endif
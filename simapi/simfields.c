@@ -0,0 +1,241 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simseqlock.h"
+#include "simlatency.h"
+#include "../simmap/basicmap.h"
+
+// a plan copies runs of bytes, fields that sit next to each other in SimData
+// and in the caller's struct, tyreRPS0 to tyreRPS3 say, become one run
+typedef struct
+{
+    uint32_t src;
+    uint32_t dst;
+    uint32_t len;
+}
+SimFieldRun;
+
+struct SimFieldPlan
+{
+    int fields;
+    size_t size;
+    size_t* offsets;
+    int runs;
+    SimFieldRun* run;
+};
+
+// CreateSimDataMap() with no SimData, so every value is an offset
+static struct Map simfields[SIMDATAMAP_SIZE];
+static pthread_once_t simfields_once = PTHREAD_ONCE_INIT;
+
+static void simfields_init(void)
+{
+    CreateSimDataMap(simfields, NULL, 0);
+}
+
+static size_t simfields_dtype_size(SimDataType dtype)
+{
+    switch (dtype)
+    {
+        case DOUBLE:
+        case UINT64:
+            return 8;
+        case INTEGER:
+        case FLOAT:
+        case UINT32:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+int simapi_field_id(const char* name)
+{
+    pthread_once(&simfields_once, simfields_init);
+    for (int k = 0; k < SIMDATAMAP_SIZE; k++)
+    {
+        if (simfields[k].name != NULL && strcmp(simfields[k].name, name) == 0)
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+SimFieldPlan* simapi_field_plan(const int* ids, int count)
+{
+    pthread_once(&simfields_once, simfields_init);
+    if (count <= 0)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (ids[i] < 0 || ids[i] >= SIMDATAMAP_SIZE)
+        {
+            return NULL;
+        }
+    }
+
+    SimFieldPlan* plan = malloc(sizeof(SimFieldPlan));
+    if (plan == NULL)
+    {
+        return NULL;
+    }
+    plan->fields = count;
+    plan->offsets = malloc(count * sizeof(size_t));
+    plan->run = malloc(count * sizeof(SimFieldRun));
+    if (plan->offsets == NULL || plan->run == NULL)
+    {
+        simapi_field_plan_free(plan);
+        return NULL;
+    }
+
+    // laid out like a C struct with the same members in the same order
+    size_t at = 0;
+    plan->runs = 0;
+    for (int i = 0; i < count; i++)
+    {
+        size_t len = simfields_dtype_size(simfields[ids[i]].dtype);
+        size_t src = (size_t) simfields[ids[i]].value;
+        at = (at + len - 1) & ~(len - 1);
+        plan->offsets[i] = at;
+
+        SimFieldRun* last = plan->runs > 0 ? &plan->run[plan->runs - 1] : NULL;
+        if (last != NULL && last->src + last->len == src && last->dst + last->len == at)
+        {
+            last->len += len;
+        }
+        else
+        {
+            plan->run[plan->runs].src = src;
+            plan->run[plan->runs].dst = at;
+            plan->run[plan->runs].len = len;
+            plan->runs++;
+        }
+        at += len;
+    }
+    plan->size = (at + 7) & ~(size_t) 7;
+    return plan;
+}
+
+SimFieldPlan* simapi_field_plan_names(const char** names, int count)
+{
+    if (count <= 0)
+    {
+        return NULL;
+    }
+    int* ids = malloc(count * sizeof(int));
+    if (ids == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        ids[i] = simapi_field_id(names[i]);
+    }
+    SimFieldPlan* plan = simapi_field_plan(ids, count);
+    free(ids);
+    return plan;
+}
+
+size_t simapi_field_plan_size(const SimFieldPlan* plan)
+{
+    return plan->size;
+}
+
+size_t simapi_field_plan_offset(const SimFieldPlan* plan, int index)
+{
+    return plan->offsets[index];
+}
+
+void simapi_field_plan_free(SimFieldPlan* plan)
+{
+    if (plan == NULL)
+    {
+        return;
+    }
+    free(plan->offsets);
+    free(plan->run);
+    free(plan);
+}
+
+static inline void simfields_gather(const SimFieldPlan* plan, const char* src, char* dst)
+{
+    for (int r = 0; r < plan->runs; r++)
+    {
+        const SimFieldRun* run = &plan->run[r];
+        memcpy(dst + run->dst, src + run->src, run->len);
+    }
+}
+
+// the fields out of the scratch, padding between them in the caller's struct is not written
+static inline void simfields_copy_out(const SimFieldPlan* plan, const char* scratch, char* dst)
+{
+    for (int r = 0; r < plan->runs; r++)
+    {
+        const SimFieldRun* run = &plan->run[r];
+        memcpy(dst + run->dst, scratch + run->dst, run->len);
+    }
+}
+
+int simapi_read_fields(SimMap* simmap, const SimFieldPlan* plan, void* dst)
+{
+    if (simmap->addr == NULL || simmap->segment != SIMAPI_SEGMENT_FULL)
+    {
+        return SIMAPI_ERROR_NODATA;
+    }
+    if (simmap->sync == NULL)
+    {
+        // daemon predates SimDataSync, nothing to synchronize against
+        simfields_gather(plan, simmap->addr, dst);
+        return SIMAPI_ERROR_NONE;
+    }
+
+    // gathered into the scratch first, on BUSY the caller's struct is left as it was
+    if (simmap->fields_scratchsize < plan->size)
+    {
+        char* scratch = realloc(simmap->fields_scratch, plan->size);
+        if (scratch == NULL)
+        {
+            return SIMAPI_ERROR_NODATA;
+        }
+        simmap->fields_scratch = scratch;
+        simmap->fields_scratchsize = plan->size;
+    }
+
+    SimFrameTimes times;
+    for (int tries = 0; tries < SIMSEQLOCK_MAX_RETRIES; tries++)
+    {
+        uint32_t seq = simseqlock_read_begin(&simmap->sync->sequence);
+        if ((seq & 1) == 0)
+        {
+            simfields_gather(plan, simmap->addr, simmap->fields_scratch);
+            simlatency_load(simmap, &times);
+            if (simseqlock_read_retry(&simmap->sync->sequence, seq) == false)
+            {
+                simfields_copy_out(plan, simmap->fields_scratch, dst);
+                simlatency_read(simmap, &times);
+                return SIMAPI_ERROR_NONE;
+            }
+        }
+
+        if (tries < SIMSEQLOCK_SPINS_BEFORE_YIELD)
+        {
+            simseqlock_relax();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return SIMAPI_ERROR_BUSY;
+}
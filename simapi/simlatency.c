@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "simdata.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simlatency.h"
+
+// the first 16 buckets are exact, after that 8 per power of two
+#define SIMLATENCY_EXACT 16
+#define SIMLATENCY_SUB_BITS 3
+
+uint64_t simapi_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// when the next frame's source was observed, if earlier than simdatamap() itself,
+// e.g. the kernel receive time of a datagram
+void simapi_source_time(SimMap* simmap, uint64_t ns)
+{
+    simmap->pending_source = ns;
+}
+
+void simapi_frame_times(SimMap* simmap, SimFrameTimes* times)
+{
+    *times = simmap->times;
+}
+
+// lets a publisher carry the times of a frame mapped with another SimMap
+void simapi_set_frame_times(SimMap* simmap, const SimFrameTimes* times)
+{
+    simmap->times = *times;
+}
+
+void simlatency_publish(SimMap* simmap)
+{
+    simmap->times.published = simapi_monotonic_ns();
+    simmap->sync->sourcetime = simmap->times.source;
+    simmap->sync->mappedtime = simmap->times.mapped;
+    simmap->sync->publishedtime = simmap->times.published;
+}
+
+void simlatency_load(const SimMap* simmap, SimFrameTimes* times)
+{
+    times->source = __atomic_load_n(&simmap->sync->sourcetime, __ATOMIC_RELAXED);
+    times->mapped = __atomic_load_n(&simmap->sync->mappedtime, __ATOMIC_RELAXED);
+    times->published = __atomic_load_n(&simmap->sync->publishedtime, __ATOMIC_RELAXED);
+}
+
+void simlatency_read(SimMap* simmap, const SimFrameTimes* times)
+{
+    simmap->times = *times;
+    simmap->times.read = simapi_monotonic_ns();
+}
+
+static int latency_bucket(uint64_t ns)
+{
+    if (ns < SIMLATENCY_EXACT)
+    {
+        return ns;
+    }
+    int e = 63 - __builtin_clzll(ns);
+    int b = SIMLATENCY_EXACT + ((e - 4) << SIMLATENCY_SUB_BITS) + ((ns >> (e - SIMLATENCY_SUB_BITS)) & ((1 << SIMLATENCY_SUB_BITS) - 1));
+    return b < SIMAPI_LATENCY_BUCKETS ? b : SIMAPI_LATENCY_BUCKETS - 1;
+}
+
+// the largest value that lands in bucket b
+static uint64_t latency_bucket_top(int b)
+{
+    if (b < SIMLATENCY_EXACT)
+    {
+        return b;
+    }
+    int e = 4 + ((b - SIMLATENCY_EXACT) >> SIMLATENCY_SUB_BITS);
+    uint64_t m = (1 << SIMLATENCY_SUB_BITS) + ((b - SIMLATENCY_EXACT) & ((1 << SIMLATENCY_SUB_BITS) - 1));
+    return ((m + 1) << (e - SIMLATENCY_SUB_BITS)) - 1;
+}
+
+void simapi_latency_add(SimLatencyHistogram* h, uint64_t ns)
+{
+    h->buckets[latency_bucket(ns)]++;
+    h->count++;
+    if (ns > h->max)
+    {
+        h->max = ns;
+    }
+}
+
+// percentile between 0 and 100, answered to within a bucket and never above the largest value seen
+uint64_t simapi_latency_percentile(const SimLatencyHistogram* h, double percentile)
+{
+    if (h->count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t want = (uint64_t) ((percentile / 100.0) * h->count);
+    if (want >= h->count)
+    {
+        want = h->count - 1;
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b < SIMAPI_LATENCY_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if (seen > want)
+        {
+            uint64_t top = latency_bucket_top(b);
+            return top < h->max ? top : h->max;
+        }
+    }
+    return h->max;
+}
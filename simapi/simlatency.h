@@ -0,0 +1,14 @@
+#ifndef _SIMLATENCY_H
+#define _SIMLATENCY_H
+
+#include "simmap.h"
+
+// frame timestamps carried in SimDataSync, see SimFrameTimes in simmapper.h
+// writers call simlatency_publish() between simseqlock_write_begin() and _end(),
+// readers simlatency_load() inside the read loop and simlatency_read() once it succeeded
+
+void simlatency_publish(SimMap* simmap);
+void simlatency_load(const SimMap* simmap, SimFrameTimes* times);
+void simlatency_read(SimMap* simmap, const SimFrameTimes* times);
+
+#endif
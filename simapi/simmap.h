@@ -1,6 +1,12 @@
 #ifndef _SIMMAP_H
 #define _SIMMAP_H
 
+#include <stddef.h>
+#include <pthread.h>
+
+#include "simdata.h"
+#include "simmapper.h"
+#include "simstrings.h"
 #include "ac.h"
 #include "rf2.h"
 #include "pcars2.h"
@@ -14,6 +20,28 @@ struct _simmap
     void* addr;
     int fd;
     bool hasSimApiDat;
+    SimApiSegment segment;
+    size_t size;
+    SimDataSync* sync;
+    SimData* shadow;
+    bool shadow_valid;
+    SimData* scratch; // simapi_read_simdata() copies here until the seqlock validates
+    char* fields_scratch; // simapi_read_fields() gathers here, simapi_field_plan_size() of the largest plan read
+    size_t fields_scratchsize;
+    uint32_t dirty; // regions of SimData mapped since the last publish, see simmap_dirty()
+    // the radar in SimData.pd and the neighbour lists of SIMAPI.CARS, see simapi_set_proximity()
+    int proximity_cars;
+    double proximity_radius;
+    double neighbour_radius;
+    SimStrings strings; // the index into SIMAPI.CARS' string table, see simstrings.h
+    uint32_t region_seen[SIMAPI_REGIONS];
+    uint32_t seen_sequence;
+    int notify_fd; // -1 until simapi_frame_fd()
+    bool notify_running;
+    pthread_t notify_thread;
+    SimSnapshotStats snapshot;
+    SimFrameTimes times;
+    uint64_t pending_source;
 
     ACMap ac;
     RF2Map rf2;
@@ -24,4 +52,17 @@ struct _simmap
     RBRMap rbr;
 };
 
+// the mappers mark the regions of SimData they wrote and simdatamap() compares
+// only those with the last published frame, the rest are known not to have changed
+#define SIMMAP_DIRTY_ALL ((uint32_t) ((1ull << SIMAPI_REGIONS) - 1))
+_Static_assert(SIMAPI_REGIONS <= 32, "one bit per region of SimData");
+
+static inline void simmap_dirty(SimMap* simmap, size_t offset, size_t len)
+{
+    for (size_t r = offset / SIMAPI_REGION_SIZE; r <= (offset + len - 1) / SIMAPI_REGION_SIZE; r++)
+    {
+        simmap->dirty |= 1u << r;
+    }
+}
+
 #endif
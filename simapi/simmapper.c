@@ -10,6 +10,8 @@
 #include <math.h>
 #include <ctype.h>
 #include <sys/time.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include "simdata.h"
 #include "simapi.h"
@@ -25,6 +27,10 @@
 #include "wreckfest2.h"
 #include "rbr.h"
 #include "simmap.h"
+#include "simseqlock.h"
+#include "simnotify.h"
+#include "simsegment.h"
+#include "simlatency.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -47,8 +53,13 @@
 SimMap* createSimMap()
 {
     SimMap* ptr = malloc(sizeof(SimMap));
+    memset(ptr, 0, sizeof(SimMap));
     ptr->fd = -1;
+    ptr->notify_fd = -1;
     ptr->addr = 0;
+    ptr->proximity_cars = PROXCARS;
+    ptr->proximity_radius = SIMAPI_PROXIMITY_RADIUS;
+    ptr->neighbour_radius = SIMAPI_NEIGHBOUR_RADIUS;
     return ptr;
 }
 
@@ -311,88 +322,6 @@ void simapi_log(SIMAPI_LOGLEVEL sll, char* message)
     }
 }
 
-void SetProximityData(SimData* simdata, int cars, int8_t lr_flip)
-{
-    double carwidth = 1.8;
-    double maxradius = 10.0;
-
-    int proxcars = PROXCARS;
-    if(cars < PROXCARS)
-    {
-        proxcars = cars;
-    }
-
-
-    for(int x = 0; x < proxcars; x++)
-    {
-        simdata->pd[x].radius = 0.0;
-        simdata->pd[x].theta = 0.0;
-    }
-    if(abs(simdata->Yvelocity) < 0.0001 && abs(simdata->Xvelocity) < 0.0001)
-    {
-        return;
-    }
-
-    double angle = atan2(-1, 0) - atan2(simdata->worldYvelocity, simdata->worldXvelocity);
-    double angleD = angle * 360 / (2 * M_PI);
-    double angleR = angleD * M_PI / 180;
-
-    double cosTheta = cos(angle);
-    double sinTheta = sin(angle);
-
-    for(int car = 1; car < cars; car++)
-    {
-        double rawXCoordinate = simdata->cars[car].xpos - simdata->worldposx;
-        double rawYCoordinate = simdata->cars[car].ypos - simdata->worldposy;
-
-        double xscore  = cosTheta * rawXCoordinate - sinTheta * rawYCoordinate;
-        double yscore  = sinTheta * rawXCoordinate + cosTheta * rawYCoordinate;
-
-        double rads = atan2(yscore, xscore * lr_flip);
-        double degrees = (rads * (180 / M_PI)) + 90.0;
-
-        double radius = sqrt((rawXCoordinate * rawXCoordinate) + (rawYCoordinate * rawYCoordinate));
-        double theta = degrees;
-        if( theta < 0 )
-        {
-            theta = 360 + degrees;
-        }
-        radius = radius - carwidth;
-
-        //fprintf(stderr, "rawx: %f, rawy: %f degs: %f mag: %f\n", rawXCoordinate, rawYCoordinate, theta, radius);
-
-        if(radius < maxradius)
-        {
-            int j = proxcars - 1;
-            if((simdata->pd[j].radius == 0) || (radius < simdata->pd[j].radius))
-            {
-                simdata->pd[j].radius = radius;
-                simdata->pd[j].theta = theta;
-
-
-                j--;
-                while(j >= 0)
-                {
-                    double tempradius = simdata->pd[j+1].radius;
-                    double temptheta = simdata->pd[j+1].theta;
-
-
-                    if((simdata->pd[j].radius == 0) || (tempradius < simdata->pd[j].radius))
-                    {
-                        simdata->pd[j+1].radius = simdata->pd[j].radius;
-                        simdata->pd[j+1].theta = simdata->pd[j].theta;
-
-                        simdata->pd[j].radius = tempradius;
-                        simdata->pd[j].theta = temptheta;
-                    }
-                    j--;
-                }
-            }
-        }
-    }
-}
-
-
 bool does_sim_file_exist(const char* file)
 {
     if (file == NULL)
@@ -571,113 +500,88 @@ void hexDump(char* desc, void* addr, int len)
     printf ("  %s\n", buff);
 }
 
-SimulatorEXE getSimExe(SimInfo* si)
+// in the order getSimExe() has always preferred them
+static const struct
 {
-    int pid = 0;
-
-    pid = IsProcessRunning(AC_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_ASSETTO_CORSA;
-    }
-    pid = IsProcessRunning(ACC_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_ASSETTO_CORSA_COMPETIZIONE;
-    }
-    pid = IsProcessRunning(ACE_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_ASSETTO_CORSA_EVO;
-    }
-    pid = IsProcessRunning(ACR_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_ASSETTO_CORSA_RALLY;
-    }
-    pid = IsProcessRunning(RFACTOR2_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_RFACTOR2;
-    }
-    pid = IsProcessRunning(AMS2_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_AUTOMOBILISTA2;
-    }
-    pid = IsProcessRunning(EUROTRUCKS2_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_EUROTRUCKS2;
-    }
-    pid = IsProcessRunning(AMERICANTRUCKS_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_AMERICANTRUCKS;
-    }
-    pid = IsProcessRunning(LEMANS_ULTIMATE_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_LEMANS_ULTIMATE;
-    }
-    pid = IsProcessRunning(LIVE_FOR_SPEED_EXE);
-    if(pid>0)
-    {
-        si->pid = pid;
-        return SIMULATOREXE_LIVE_FOR_SPEED;
-    }
-    pid = IsProcessRunning(BEAMNG_EXE);
-    if(pid>0)
+    const char* exe;
+    SimulatorEXE sim;
+}
+simexes[] =
+{
+    { AC_EXE, SIMULATOREXE_ASSETTO_CORSA },
+    { ACC_EXE, SIMULATOREXE_ASSETTO_CORSA_COMPETIZIONE },
+    { ACE_EXE, SIMULATOREXE_ASSETTO_CORSA_EVO },
+    { ACR_EXE, SIMULATOREXE_ASSETTO_CORSA_RALLY },
+    { RFACTOR2_EXE, SIMULATOREXE_RFACTOR2 },
+    { AMS2_EXE, SIMULATOREXE_AUTOMOBILISTA2 },
+    { EUROTRUCKS2_EXE, SIMULATOREXE_EUROTRUCKS2 },
+    { AMERICANTRUCKS_EXE, SIMULATOREXE_AMERICANTRUCKS },
+    { LEMANS_ULTIMATE_EXE, SIMULATOREXE_LEMANS_ULTIMATE },
+    { LIVE_FOR_SPEED_EXE, SIMULATOREXE_LIVE_FOR_SPEED },
+    { BEAMNG_EXE, SIMULATOREXE_BEAMNG },
+    { DIRT_RALLY_2_EXE, SIMULATOREXE_DIRT_RALLY_2 },
+    { F1_2022_EXE, SIMULATOREXE_F1_2022 },
+    { WRECKFEST2_EXE, SIMULATOREXE_WRECKFEST2 },
+    { RICHARD_BURNS_RALLY_EXE, SIMULATOREXE_RICHARD_BURNS_RALLY },
+    //{ FORZA_HORIZON_5_EXE, SIMULATOREXE_FORZA_HORIZON_5 },
+    //{ RACE_ROOM_EXE, SIMULATOREXE_RACE_ROOM },
+};
+
+int simapi_procscan_add_sims(ProcScan* ps)
+{
+    int first = -1;
+    for (size_t i = 0; i < sizeof(simexes) / sizeof(simexes[0]); i++)
     {
-        si->pid = pid;
-        return SIMULATOREXE_BEAMNG;
+        int index = procscan_add(ps, simexes[i].exe);
+        if (i == 0)
+        {
+            first = index;
+        }
     }
-    pid = IsProcessRunning(DIRT_RALLY_2_EXE);
-    if(pid>0)
+    return first;
+}
+
+SimulatorEXE simapi_procscan_sim(ProcScan* ps, int first, SimInfo* si)
+{
+    if (first < 0)
     {
-        si->pid = pid;
-        return SIMULATOREXE_DIRT_RALLY_2;
+        return SIMULATOREXE_SIMAPI_TEST_NONE;
     }
-    pid = IsProcessRunning(F1_2022_EXE);
-    if(pid>0)
+    for (size_t i = 0; i < sizeof(simexes) / sizeof(simexes[0]); i++)
     {
-        si->pid = pid;
-        return SIMULATOREXE_F1_2022;
+        int pid = procscan_pid(ps, first + (int) i);
+        if (pid > 0)
+        {
+            si->pid = pid;
+            return simexes[i].sim;
+        }
     }
-    pid = IsProcessRunning(WRECKFEST2_EXE);
-    if(pid>0)
+    return SIMULATOREXE_SIMAPI_TEST_NONE;
+}
+
+SimulatorEXE getSimExe(SimInfo* si)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static ProcScan* ps = NULL;
+    static int first = -1;
+
+    pthread_mutex_lock(&lock);
+    if (ps == NULL)
     {
-        si->pid = pid;
-        return SIMULATOREXE_WRECKFEST2;
+        ps = procscan_create();
+        if (ps != NULL)
+        {
+            first = simapi_procscan_add_sims(ps);
+        }
     }
-    pid = IsProcessRunning(RICHARD_BURNS_RALLY_EXE);
-    if(pid>0)
+
+    SimulatorEXE sim = SIMULATOREXE_SIMAPI_TEST_NONE;
+    if (ps != NULL && procscan_run(ps) > 0)
     {
-        si->pid = pid;
-        return SIMULATOREXE_RICHARD_BURNS_RALLY;
+        sim = simapi_procscan_sim(ps, first, si);
     }
-    //pid = IsProcessRunning(FORZA_HORIZON_5_EXE);
-    //if(pid>0)
-    //{
-    //    si->pid = pid;
-    //    return SIMULATOREXE_FORZA_HORIZON_5;
-    //}
-    //pid = IsProcessRunning(RACE_ROOM_EXE);
-    //if(pid>0)
-    //{
-    //    si->pid = pid;
-    //    return SIMULATOREXE_RACE_ROOM;
-    //}
-    return SIMULATOREXE_SIMAPI_TEST_NONE;
+    pthread_mutex_unlock(&lock);
+    return sim;
 }
 
 
@@ -1048,6 +952,8 @@ SimInfo getSim(SimData* simdata, SimMap* simmap, bool force_udp, int (*setup_udp
     return si;
 }
 
+static int simdmap_regions(SimMap* simmap, SimData* simdata, uint32_t dirty);
+
 int simdatamap(SimData* simdata, SimMap* simmap, SimMap* simmap2, SimulatorAPI simulatorapi, bool udp, char* base)
 {
     char* a;
@@ -1056,6 +962,17 @@ int simdatamap(SimData* simdata, SimMap* simmap, SimMap* simmap2, SimulatorAPI s
     char* d;
 
     simdata->mtick = timeInMilliseconds();
+    if (simmap != NULL)
+    {
+        simmap_dirty(simmap, offsetof(SimData, mtick), sizeof(simdata->mtick));
+        // simapi, simexe and simon are set by getSim(), not by a mapper, and the
+        // mappers that mark what they wrote only mark pd when their car page moves
+        simmap_dirty(simmap, offsetof(SimData, pd), sizeof(SimData) - offsetof(SimData, pd));
+        uint64_t now = simapi_monotonic_ns();
+        simmap->times.source = simmap->pending_source != 0 && simmap->pending_source <= now ? simmap->pending_source : now;
+        simmap->times.mapped = 0;
+        simmap->pending_source = 0;
+    }
 
     switch ( simulatorapi )
     {
@@ -1064,7 +981,7 @@ int simdatamap(SimData* simdata, SimMap* simmap, SimMap* simmap2, SimulatorAPI s
             double tyre1 = simdata->tyrediameter[1];
             double tyre2 = simdata->tyrediameter[2];
             double tyre3 = simdata->tyrediameter[3];
-            memcpy(simdata, simmap->addr, sizeof(SimData));
+            int err = simapi_read_simdata(simmap, simdata);
             if(simdata->simapi != SIMULATORAPI_ASSETTO_CORSA)
             {
                 simdata->tyrediameter[0] = tyre0;
@@ -1072,7 +989,7 @@ int simdatamap(SimData* simdata, SimMap* simmap, SimMap* simmap2, SimulatorAPI s
                 simdata->tyrediameter[2] = tyre2;
                 simdata->tyrediameter[3] = tyre3;
             }
-            return 0;
+            return err;
         case SIMULATORAPI_ASSETTO_CORSA :
 
             map_assetto_corsa_data(simdata, simmap, simdata->simexe);
@@ -1129,17 +1046,250 @@ int simdatamap(SimData* simdata, SimMap* simmap, SimMap* simmap2, SimulatorAPI s
         case SIMULATORAPI_LMU:
             break;
     }
+    // the AC and rF2 mappers know which source pages moved and mark what they wrote
+    if (simmap != NULL && simulatorapi != SIMULATORAPI_ASSETTO_CORSA && simulatorapi != SIMULATORAPI_RFACTOR2)
+    {
+        simmap->dirty = SIMMAP_DIRTY_ALL;
+    }
+
+    if (simmap != NULL)
+    {
+        simmap->times.mapped = simapi_monotonic_ns();
+    }
 
     if (simmap2 != NULL && simmap2->addr != NULL)
     {
-        simdmap(simmap2, simdata);
+        uint32_t dirty = SIMMAP_DIRTY_ALL;
+        if (simmap != NULL)
+        {
+            simmap2->times = simmap->times;
+            dirty = simmap->dirty;
+            simmap->dirty = 0;
+        }
+        simdmap_regions(simmap2, simdata, dirty);
     }
 
 }
 
+// only the regions in dirty can differ from the last frame, the others are not even compared
+static int simdmap_regions(SimMap* simmap, SimData* simdata, uint32_t dirty)
+{
+    // opensimmap() failed, there is nothing to publish to
+    if (simmap->addr == NULL)
+    {
+        return 1;
+    }
+    if (simmap->sync == NULL)
+    {
+        memcpy(simmap->addr, simdata, sizeof(SimData));
+        return 0;
+    }
+
+    // compare against our own copy of the last frame instead of the mapping,
+    // so unchanged cache lines are never written and stay valid in the readers' caches
+    const char* src = (const char*) simdata;
+    char* shadow = (char*) simmap->shadow;
+    char* dst = (char*) simmap->addr;
+    uint32_t gen = (uint32_t) (simmap->sync->frames + 1);
+    // what simd --poke wrote straight into the mapping is put back whole, whatever the shadow says
+    uint32_t poked = __atomic_exchange_n(&simmap->sync->poked, 0, __ATOMIC_ACQUIRE);
+    if (simmap->shadow_valid == false)
+    {
+        dirty = SIMMAP_DIRTY_ALL;
+    }
+
+    simseqlock_write_begin(&simmap->sync->sequence);
+    for (size_t r = 0; r < SIMAPI_REGIONS; r++)
+    {
+        if (((dirty | poked) & (1u << r)) == 0)
+        {
+            continue;
+        }
+        size_t end = sizeof(SimData) < (r + 1) * SIMAPI_REGION_SIZE ? sizeof(SimData) : (r + 1) * SIMAPI_REGION_SIZE;
+        bool whole = simmap->shadow_valid == false || (poked & (1u << r)) != 0;
+        for (size_t off = r * SIMAPI_REGION_SIZE; off < end; off += SIMAPI_CACHELINE)
+        {
+            size_t len = end - off < SIMAPI_CACHELINE ? end - off : SIMAPI_CACHELINE;
+            if (whole == false && memcmp(src + off, shadow + off, len) == 0)
+            {
+                continue;
+            }
+            memcpy(dst + off, src + off, len);
+            memcpy(shadow + off, src + off, len);
+            simmap->sync->regions[r] = gen;
+        }
+    }
+    simmap->shadow_valid = true;
+    simmap->sync->frames++;
+    simlatency_publish(simmap);
+    simseqlock_write_end(&simmap->sync->sequence);
+    simnotify_wake(&simmap->sync->sequence);
+    return 0;
+}
+
+// callers that wrote SimData themselves, everything is compared
 int simdmap(SimMap* simmap, SimData* simdata)
 {
-    memcpy(simmap->addr, simdata, sizeof(SimData));
+    return simdmap_regions(simmap, simdata, SIMMAP_DIRTY_ALL);
+}
+
+int simapi_read_simdata(SimMap* simmap, SimData* simdata)
+{
+    if (simmap->sync == NULL)
+    {
+        // daemon predates SimDataSync, nothing to synchronize against
+        memcpy(simdata, simmap->addr, sizeof(SimData));
+        return SIMAPI_ERROR_NONE;
+    }
+
+    // copies go to the scratch frame first, on BUSY the caller's SimData is left as it was
+    if (simmap->scratch == NULL)
+    {
+        simmap->scratch = malloc(sizeof(SimData));
+        if (simmap->scratch == NULL)
+        {
+            return SIMAPI_ERROR_NODATA;
+        }
+    }
+
+    SimFrameTimes times;
+    for (int tries = 0; tries < SIMSEQLOCK_MAX_RETRIES; tries++)
+    {
+        uint32_t seq = simseqlock_read_begin(&simmap->sync->sequence);
+        if ((seq & 1) == 0)
+        {
+            memcpy(simmap->scratch, simmap->addr, sizeof(SimData));
+            simlatency_load(simmap, &times);
+            if (simseqlock_read_retry(&simmap->sync->sequence, seq) == false)
+            {
+                memcpy(simdata, simmap->scratch, sizeof(SimData));
+                simlatency_read(simmap, &times);
+                return SIMAPI_ERROR_NONE;
+            }
+        }
+
+        if (tries < SIMSEQLOCK_SPINS_BEFORE_YIELD)
+        {
+            simseqlock_relax();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return SIMAPI_ERROR_BUSY;
+}
+
+int simapi_read_simdata_changed(SimMap* simmap, SimData* simdata)
+{
+    if (simmap->sync == NULL)
+    {
+        return simapi_read_simdata(simmap, simdata);
+    }
+
+    if (simmap->scratch == NULL)
+    {
+        simmap->scratch = malloc(sizeof(SimData));
+        if (simmap->scratch == NULL)
+        {
+            return SIMAPI_ERROR_NODATA;
+        }
+    }
+
+    uint32_t gens[SIMAPI_REGIONS];
+    SimFrameTimes times;
+    for (int tries = 0; tries < SIMSEQLOCK_MAX_RETRIES; tries++)
+    {
+        uint32_t seq = simseqlock_read_begin(&simmap->sync->sequence);
+        if ((seq & 1) == 0)
+        {
+            uint32_t copied = 0;
+            for (size_t r = 0; r < SIMAPI_REGIONS; r++)
+            {
+                gens[r] = __atomic_load_n(&simmap->sync->regions[r], __ATOMIC_RELAXED);
+                if (gens[r] != simmap->region_seen[r])
+                {
+                    size_t off = r * SIMAPI_REGION_SIZE;
+                    size_t len = sizeof(SimData) - off < SIMAPI_REGION_SIZE ? sizeof(SimData) - off : SIMAPI_REGION_SIZE;
+                    memcpy((char*) simmap->scratch + off, (char*) simmap->addr + off, len);
+                    copied |= 1u << r;
+                }
+            }
+            simlatency_load(simmap, &times);
+            // only hand over and remember what we copied once the whole frame was consistent
+            if (simseqlock_read_retry(&simmap->sync->sequence, seq) == false)
+            {
+                for (size_t r = 0; r < SIMAPI_REGIONS; r++)
+                {
+                    if ((copied & (1u << r)) != 0)
+                    {
+                        size_t off = r * SIMAPI_REGION_SIZE;
+                        size_t len = sizeof(SimData) - off < SIMAPI_REGION_SIZE ? sizeof(SimData) - off : SIMAPI_REGION_SIZE;
+                        memcpy((char*) simdata + off, (char*) simmap->scratch + off, len);
+                    }
+                }
+                memcpy(simmap->region_seen, gens, sizeof(gens));
+                simlatency_read(simmap, &times);
+                return SIMAPI_ERROR_NONE;
+            }
+        }
+
+        if (tries < SIMSEQLOCK_SPINS_BEFORE_YIELD)
+        {
+            simseqlock_relax();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return SIMAPI_ERROR_BUSY;
+}
+
+bool simapi_source_frame(SimMap* simmap, SimulatorAPI simulator, uint64_t* frame)
+{
+    char* a;
+    char* b;
+
+    switch ( simulator )
+    {
+        case SIMULATORAPI_RFACTOR2 :
+            if (simmap->rf2.has_telemetry == false || simmap->rf2.has_scoring == false)
+            {
+                return false;
+            }
+            // the plugin bumps mVersionUpdateEnd once a buffer is fully written
+            a = simmap->rf2.telemetry_map_addr;
+            b = simmap->rf2.scoring_map_addr;
+            *frame = ((uint64_t) (uint32_t) __atomic_load_n((int*) (a + offsetof(struct rF2Telemetry, mVersionUpdateEnd)), __ATOMIC_ACQUIRE) << 32)
+                     | (uint32_t) __atomic_load_n((int*) (b + offsetof(struct rF2Scoring, mVersionUpdateEnd)), __ATOMIC_ACQUIRE);
+            return true;
+
+        case SIMULATORAPI_PROJECTCARS2 :
+            if (simmap->pcars2.has_telemetry == false)
+            {
+                return false;
+            }
+            // odd while the game is writing, so report the last complete frame
+            a = simmap->pcars2.telemetry_map_addr;
+            *frame = __atomic_load_n((unsigned int*) (a + offsetof(struct pcars2APIStruct, mSequenceNumber)), __ATOMIC_ACQUIRE) & ~1u;
+            return true;
+
+        case SIMULATORAPI_ASSETTO_CORSA :
+            if (simmap->ac.has_physics == false || simmap->ac.has_graphic == false)
+            {
+                return false;
+            }
+            a = simmap->ac.physics_map_addr;
+            b = simmap->ac.graphic_map_addr;
+            *frame = ((uint64_t) (uint32_t) __atomic_load_n((int*) (a + offsetof(struct SPageFilePhysics, packetId)), __ATOMIC_ACQUIRE) << 32)
+                     | (uint32_t) __atomic_load_n((int*) (b + offsetof(struct SPageFileGraphic, packetId)), __ATOMIC_ACQUIRE);
+            return true;
+
+        default:
+            // no change counter in the source, the caller has to keep polling
+            return false;
+    }
 }
 
 int siminitudp(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
@@ -1171,78 +1321,104 @@ int siminit(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
                 return 10;
             }
 
-            simmap->addr = mmap(NULL, sizeof(SimData), PROT_READ, MAP_SHARED, simmap->fd, 0);
+            // older daemons publish a bare SimData without the sync block
+            struct stat st;
+            simmap->size = sizeof(SimData);
+            if (fstat(simmap->fd, &st) == 0 && st.st_size >= (off_t) SIMAPI_MEM_SIZE)
+            {
+                simmap->size = SIMAPI_MEM_SIZE;
+            }
+
+            simmap->addr = mmap(NULL, simmap->size, PROT_READ, MAP_SHARED, simmap->fd, 0);
             if (simmap->addr == MAP_FAILED)
             {
                 return 30;
             }
+            simmap->sync = NULL;
+            if (simmap->size == SIMAPI_MEM_SIZE)
+            {
+                simmap->sync = (SimDataSync*) ((char*) simmap->addr + SIMAPI_SYNC_OFFSET);
+            }
             simmap->hasSimApiDat = true;
             //slogi("found data for monocoque test...");
             break;
 
         case SIMULATORAPI_ASSETTO_CORSA :
 
-            if(simmap->ac.has_physics == true)
-            {
-                return 0;
-            }
-            simmap->ac.has_physics=false;
-            simmap->ac.has_static=false;
-            simmap->ac.fd_physics = shm_open(AC_PHYSICS_FILE, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
-            if (simmap->ac.fd_physics == -1)
-            {
-                //slogd("could not open Assetto Corsa physics engine");
-                return SIMAPI_ERROR_NODATA;
-            }
-            simmap->ac.physics_map_addr = mmap(NULL, sizeof(simmap->ac.ac_physics), PROT_READ, MAP_SHARED, simmap->ac.fd_physics, 0);
-            if (simmap->ac.physics_map_addr == MAP_FAILED)
+            // each file keeps its own attach state, so a retry while the bridge
+            // is still creating them only opens what is missing and never remaps
+            if(simmap->ac.has_physics == false)
             {
-                //slogd("could not retrieve Assetto Corsa physics data");
-                return 30;
+                simmap->ac.fd_physics = shm_open(AC_PHYSICS_FILE, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+                if (simmap->ac.fd_physics == -1)
+                {
+                    //slogd("could not open Assetto Corsa physics engine");
+                    return SIMAPI_ERROR_NODATA;
+                }
+                simmap->ac.physics_map_addr = mmap(NULL, sizeof(simmap->ac.ac_physics), PROT_READ, MAP_SHARED, simmap->ac.fd_physics, 0);
+                if (simmap->ac.physics_map_addr == MAP_FAILED)
+                {
+                    //slogd("could not retrieve Assetto Corsa physics data");
+                    close(simmap->ac.fd_physics);
+                    return 30;
+                }
+                simmap->ac.has_physics=true;
             }
-            simmap->ac.has_physics=true;
 
-            simmap->ac.fd_static = shm_open(AC_STATIC_FILE, O_RDWR|O_CREAT, S_IRUSR | S_IWUSR);
-            if (simmap->ac.fd_static == -1)
+            if(simmap->ac.has_static == false)
             {
-                //slogd("could not open Assetto Corsa static data");
-                return 10;
-            }
-            simmap->ac.static_map_addr = mmap(NULL, sizeof(simmap->ac.ac_static), PROT_READ, MAP_SHARED, simmap->ac.fd_static, 0);
-            if (simmap->ac.static_map_addr == MAP_FAILED)
-            {
-                //slogd("could not retrieve Assetto Corsa static data");
-                return 30;
+                simmap->ac.fd_static = shm_open(AC_STATIC_FILE, O_RDWR|O_CREAT, S_IRUSR | S_IWUSR);
+                if (simmap->ac.fd_static == -1)
+                {
+                    //slogd("could not open Assetto Corsa static data");
+                    return 10;
+                }
+                simmap->ac.static_map_addr = mmap(NULL, sizeof(simmap->ac.ac_static), PROT_READ, MAP_SHARED, simmap->ac.fd_static, 0);
+                if (simmap->ac.static_map_addr == MAP_FAILED)
+                {
+                    //slogd("could not retrieve Assetto Corsa static data");
+                    close(simmap->ac.fd_static);
+                    return 30;
+                }
+                simmap->ac.has_static=true;
             }
-            simmap->ac.has_static=true;
 
-            simmap->ac.fd_graphic = shm_open(AC_GRAPHIC_FILE, O_RDWR|O_CREAT, S_IRUSR | S_IWUSR);
-            if (simmap->ac.fd_graphic == -1)
+            if(simmap->ac.has_graphic == false)
             {
-                //slogd("could not open Assetto Corsa graphic data");
-                return 10;
-            }
-            simmap->ac.graphic_map_addr = mmap(NULL, sizeof(simmap->ac.ac_graphic), PROT_READ, MAP_SHARED, simmap->ac.fd_graphic, 0);
-            if (simmap->ac.graphic_map_addr == MAP_FAILED)
-            {
-                //slogd("could not retrieve Assetto Corsa static data");
-                return 30;
+                simmap->ac.fd_graphic = shm_open(AC_GRAPHIC_FILE, O_RDWR|O_CREAT, S_IRUSR | S_IWUSR);
+                if (simmap->ac.fd_graphic == -1)
+                {
+                    //slogd("could not open Assetto Corsa graphic data");
+                    return 10;
+                }
+                simmap->ac.graphic_map_addr = mmap(NULL, sizeof(simmap->ac.ac_graphic), PROT_READ, MAP_SHARED, simmap->ac.fd_graphic, 0);
+                if (simmap->ac.graphic_map_addr == MAP_FAILED)
+                {
+                    //slogd("could not retrieve Assetto Corsa static data");
+                    close(simmap->ac.fd_graphic);
+                    return 30;
+                }
+                simmap->ac.has_graphic=true;
             }
-            simmap->ac.has_graphic=true;
+
             //slogi("found data for Assetto Corsa...");
-            simmap->ac.fd_crewchief = shm_open(AC_CREWCHIEF_FILE, O_RDWR|O_CREAT, S_IRUSR | S_IWUSR);
-            if (simmap->ac.fd_crewchief == -1)
-            {
-                //slogd("could not open Assetto Corsa graphic data");
-                return 10;
-            }
-            simmap->ac.crewchief_map_addr = mmap(NULL, sizeof(simmap->ac.ac_crewchief), PROT_READ, MAP_SHARED, simmap->ac.fd_crewchief, 0);
-            if (simmap->ac.crewchief_map_addr == MAP_FAILED)
+            if(simmap->ac.has_crewchief == false)
             {
-                //slogd("could not retrieve Assetto Corsa static data");
-                return 30;
+                simmap->ac.fd_crewchief = shm_open(AC_CREWCHIEF_FILE, O_RDWR|O_CREAT, S_IRUSR | S_IWUSR);
+                if (simmap->ac.fd_crewchief == -1)
+                {
+                    //slogd("could not open Assetto Corsa graphic data");
+                    return 10;
+                }
+                simmap->ac.crewchief_map_addr = mmap(NULL, sizeof(simmap->ac.ac_crewchief), PROT_READ, MAP_SHARED, simmap->ac.fd_crewchief, 0);
+                if (simmap->ac.crewchief_map_addr == MAP_FAILED)
+                {
+                    //slogd("could not retrieve Assetto Corsa static data");
+                    close(simmap->ac.fd_crewchief);
+                    return 30;
+                }
+                simmap->ac.has_crewchief=true;
             }
-            simmap->ac.has_crewchief=true;
 
             break;
 
@@ -1271,38 +1447,41 @@ int siminit(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
 
         case SIMULATORAPI_RFACTOR2 :
 
-            if(simmap->rf2.has_telemetry == true)
-            {
-                return 0;
-            }
-            simmap->rf2.has_telemetry=false;
-            simmap->rf2.has_scoring=false;
-            simmap->rf2.fd_telemetry = shm_open(RF2_TELEMETRY_FILE, O_RDONLY, S_IRUSR | S_IWUSR);
-            if (simmap->rf2.fd_telemetry == -1)
+            // the plugin creates telemetry before scoring, keep whichever is already mapped
+            if(simmap->rf2.has_telemetry == false)
             {
-                //slogd("could not open RFactor2 Telemetry engine");
-                return SIMAPI_ERROR_NODATA;
-            }
-            simmap->rf2.telemetry_map_addr = mmap(NULL, sizeof(simmap->rf2.rf2_telemetry), PROT_READ, MAP_SHARED, simmap->rf2.fd_telemetry, 0);
-            if (simmap->rf2.telemetry_map_addr == MAP_FAILED)
-            {
-                //slogd("could not retrieve RFactor2 telemetry data");
-                return 30;
-            }
-            simmap->rf2.has_telemetry=true;
-            simmap->rf2.fd_scoring = shm_open(RF2_SCORING_FILE, O_RDONLY, S_IRUSR | S_IWUSR);
-            if (simmap->rf2.fd_scoring == -1)
-            {
-                //slogd("could not open RFactor2 Telemetry engine");
-                return SIMAPI_ERROR_NODATA;
+                simmap->rf2.fd_telemetry = shm_open(RF2_TELEMETRY_FILE, O_RDONLY, S_IRUSR | S_IWUSR);
+                if (simmap->rf2.fd_telemetry == -1)
+                {
+                    //slogd("could not open RFactor2 Telemetry engine");
+                    return SIMAPI_ERROR_NODATA;
+                }
+                simmap->rf2.telemetry_map_addr = mmap(NULL, sizeof(simmap->rf2.rf2_telemetry), PROT_READ, MAP_SHARED, simmap->rf2.fd_telemetry, 0);
+                if (simmap->rf2.telemetry_map_addr == MAP_FAILED)
+                {
+                    //slogd("could not retrieve RFactor2 telemetry data");
+                    close(simmap->rf2.fd_telemetry);
+                    return 30;
+                }
+                simmap->rf2.has_telemetry=true;
             }
-            simmap->rf2.scoring_map_addr = mmap(NULL, sizeof(simmap->rf2.rf2_scoring), PROT_READ, MAP_SHARED, simmap->rf2.fd_scoring, 0);
-            if (simmap->rf2.scoring_map_addr == MAP_FAILED)
+            if(simmap->rf2.has_scoring == false)
             {
-                //slogd("could not retrieve RFactor2 telemetry data");
-                return 30;
+                simmap->rf2.fd_scoring = shm_open(RF2_SCORING_FILE, O_RDONLY, S_IRUSR | S_IWUSR);
+                if (simmap->rf2.fd_scoring == -1)
+                {
+                    //slogd("could not open RFactor2 Telemetry engine");
+                    return SIMAPI_ERROR_NODATA;
+                }
+                simmap->rf2.scoring_map_addr = mmap(NULL, sizeof(simmap->rf2.rf2_scoring), PROT_READ, MAP_SHARED, simmap->rf2.fd_scoring, 0);
+                if (simmap->rf2.scoring_map_addr == MAP_FAILED)
+                {
+                    //slogd("could not retrieve RFactor2 telemetry data");
+                    close(simmap->rf2.fd_scoring);
+                    return 30;
+                }
+                simmap->rf2.has_scoring=true;
             }
-            simmap->rf2.has_scoring=true;
 
 
             //slogi("found data for RFactor2...");
@@ -1353,6 +1532,7 @@ int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
         }
 
         simmap->ac.has_physics = false;
+        simmap->ac.physics_copied = false;
     }
     if(simmap->ac.has_static==true)
     {
@@ -1367,6 +1547,7 @@ int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
         }
 
         simmap->ac.has_static = false;
+        simmap->ac.static_copied = false;
     }
 
     if(simmap->ac.has_graphic==true)
@@ -1382,6 +1563,7 @@ int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
         }
 
         simmap->ac.has_graphic = false;
+        simmap->ac.graphic_copied = false;
     }
 
     if(simmap->ac.has_crewchief==true)
@@ -1397,6 +1579,7 @@ int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
         }
 
         simmap->ac.has_crewchief = false;
+        simmap->ac.crewchief_copied = false;
     }
 
     if(simmap->pcars2.has_telemetry==true)
@@ -1427,6 +1610,7 @@ int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
         }
 
         simmap->rf2.has_telemetry = false;
+        simmap->rf2.telemetry_copied = false;
     }
     if(simmap->rf2.has_scoring==true)
     {
@@ -1441,6 +1625,7 @@ int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator)
         }
 
         simmap->rf2.has_scoring = false;
+        simmap->rf2.scoring_copied = false;
     }
 
     if(simmap->scs2.has_telemetry==true)
@@ -1472,19 +1657,23 @@ int freesimmap(SimMap* simmap, bool issimd)
 {
     simapi_log(SIMAPI_LOGLEVEL_INFO, "Freeing universal shared memory");
 
+    simapi_frame_fd_close(simmap);
+
     if(simmap->fd == -1)
     {
+        free(simmap->scratch);
+        free(simmap->fields_scratch);
         free(simmap);
         return 0;
     }
 
-    if (munmap(simmap->addr, sizeof(SimData)) == -1)
+    if (munmap(simmap->addr, simmap->size) == -1)
     {
         return 100;
     }
     if(issimd == true)
     {
-        shm_unlink(SIMAPI_MEM_FILE);
+        shm_unlink(simsegment_file(simmap->segment));
     }
 
     if (close(simmap->fd) == -1)
@@ -1492,6 +1681,9 @@ int freesimmap(SimMap* simmap, bool issimd)
         return 200;
     }
     simmap->hasSimApiDat = false;
+    free(simmap->shadow);
+    free(simmap->scratch);
+    free(simmap->fields_scratch);
     free(simmap);
     return 0;
 }
@@ -1505,20 +1697,30 @@ int opensimmap(SimMap* simmap)
         printf("open");
         return 10;
     }
-    int res = ftruncate(simmap->fd, sizeof(SimData));
+    int res = ftruncate(simmap->fd, SIMAPI_MEM_SIZE);
     if (res == -1)
     {
         printf("ftruncate");
         return 20;
     }
 
-    void* addr = mmap(NULL, sizeof(SimData), PROT_WRITE, MAP_SHARED, simmap->fd, 0);
+    void* addr = mmap(NULL, SIMAPI_MEM_SIZE, PROT_WRITE, MAP_SHARED, simmap->fd, 0);
     if (addr == MAP_FAILED)
     {
         printf("mmap");
         return 30;
     }
+    simmap->shadow = malloc(sizeof(SimData));
+    if (simmap->shadow == NULL)
+    {
+        printf("malloc");
+        munmap(addr, SIMAPI_MEM_SIZE);
+        return 40;
+    }
     simmap->addr = addr;
+    simmap->size = SIMAPI_MEM_SIZE;
+    simmap->sync = (SimDataSync*) ((char*) addr + SIMAPI_SYNC_OFFSET);
+    simmap->shadow_valid = false;
     return 0;
 }
 
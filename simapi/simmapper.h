@@ -41,6 +41,67 @@ SimInfo;
 //}
 //SimMap;
 
+// which file in /dev/shm a SimMap publishes or reads
+typedef enum
+{
+    SIMAPI_SEGMENT_FULL  = 0, // SIMAPI.DAT, the whole SimData
+    SIMAPI_SEGMENT_HOT   = 1, // SIMAPI.HOT, SimDataHot
+    SIMAPI_SEGMENT_COLD  = 2, // SIMAPI.COLD, SimDataCold
+    SIMAPI_SEGMENT_RING  = 3, // SIMAPI.RING, the last frames of physics as SimRingFrame
+    SIMAPI_SEGMENT_CARS  = 4, // SIMAPI.CARS, SimDataCars
+}
+SimApiSegment;
+
+// counted by libsimapi while copying source shared memory, see simapi_snapshot_stats()
+typedef struct
+{
+    uint64_t reads;
+    uint64_t torn; // copies thrown away because the sim was writing
+    uint64_t failed; // gave up retrying and mapped a possibly torn copy
+}
+SimSnapshotStats;
+
+// CLOCK_MONOTONIC ns timestamps of one frame on its way from the sim to a reader, 0 where unknown
+// simd stamps source, mapped and published, the reading functions add read
+typedef struct
+{
+    uint64_t source;
+    uint64_t mapped;
+    uint64_t published;
+    uint64_t read;
+}
+SimFrameTimes;
+
+// latency in ns, buckets 12.5% wide, see simapi_latency_add()
+#define SIMAPI_LATENCY_BUCKETS 256
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t max;
+    uint32_t buckets[SIMAPI_LATENCY_BUCKETS];
+}
+SimLatencyHistogram;
+
+// the player's radar, see simapi_proximity()
+#define SIMAPI_PROXIMITY_RADIUS 10.0
+#define SIMAPI_PROXIMITY_CARWIDTH 1.8
+// the neighbour lists in SIMAPI.CARS, see simapi_set_neighbours()
+#define SIMAPI_NEIGHBOUR_RADIUS 50.0
+
+typedef struct
+{
+    double x; // player world position
+    double y;
+    double vx; // player world velocity, theta is measured from the direction of travel
+    double vy;
+    double radius; // metres of gap between the cars, after carwidth
+    double carwidth;
+    int self; // the player's index in xpos/ypos, -1 if it is not there
+    int8_t lr_flip; // -1 for sims whose x axis points the other way
+}
+SimProximityQuery;
+
 //struct _simmap;
 typedef struct _simmap SimMap;
 
@@ -61,12 +122,33 @@ SimCompatMap;
 
 bool does_sim_need_bridge(SimulatorEXE s);
 SimulatorEXE getSimExe(SimInfo* si);
+// lets a caller with its own ProcScan (see getpid.h) look for the sims in the same /proc pass
+// returns the index of the first sim name, pass it back to simapi_procscan_sim() after procscan_run()
+typedef struct ProcScan ProcScan;
+int simapi_procscan_add_sims(ProcScan* ps);
+SimulatorEXE simapi_procscan_sim(ProcScan* ps, int first, SimInfo* si);
 SimInfo getSim(SimData* simdata, SimMap* simmap, bool force_udp, int (*setup_udp)(int), bool simd);
 int siminit(SimData* simdata, SimMap* simmap, SimulatorAPI simulator);
 int siminitudp(SimData* simdata, SimMap* simmap, SimulatorAPI simulator);
 int simdatamap(SimData* simdata, SimMap* simmap, SimMap* simmap2, SimulatorAPI simulator, bool udp, char* base);
+bool simapi_source_frame(SimMap* simmap, SimulatorAPI simulator, uint64_t* frame);
 int simfree(SimData* simdata, SimMap* simmap, SimulatorAPI simulator);
 
+// raw source capture and replay, see simsource.h
+// capture after each simdatamap(), base/len being the datagram for udp sims or NULL for shared memory
+// a capture is written out by its own thread, simapi_capture_frame() never blocks, drops the frame
+// when the writer is behind and fails from the first failed write on, closing writes out the rest
+// replay runs the captured source back through simdatamap(), SIMAPI_ERROR_NODATA at the end of the file
+typedef struct SimSourceFile SimSourceFile;
+SimSourceFile* simapi_capture_open(const char* path, SimulatorAPI simulator, SimulatorEXE simexe);
+int simapi_capture_frame(SimSourceFile* f, SimMap* simmap, const char* base, size_t len);
+// frames given to simapi_capture_frame() and dropped by it, read it from the same thread
+void simapi_capture_stats(SimSourceFile* f, uint64_t* frames, uint64_t* dropped);
+void simapi_capture_close(SimSourceFile* f);
+SimSourceFile* simapi_replay_open(const char* path, SimulatorAPI* simulator, SimulatorEXE* simexe);
+int simapi_replay_frame(SimSourceFile* f, SimData* simdata, SimMap* simmap, bool realtime);
+void simapi_replay_close(SimSourceFile* f, SimMap* simmap);
+
 int simapi_strtogame(const char* game);
 char* simapi_gametostr(SimulatorEXE sim);
 char* simapi_gametofullstr(SimulatorEXE sim);
@@ -74,12 +156,67 @@ char* simapi_gametofullstr(SimulatorEXE sim);
 SimMap* createSimMap(void);
 void* getSimMapPtr(SimMap* simmap);
 int simdmap(SimMap* simmap, SimData* simdata);
+// SIMAPI_ERROR_BUSY when simd kept writing, simdata is then left untouched
+int simapi_read_simdata(SimMap* simmap, SimData* simdata);
+int simapi_read_simdata_changed(SimMap* simmap, SimData* simdata);
+
+// reading a few fields of SIMAPI.DAT instead of all of SimData
+// fields are named or numbered as in CreateSimDataMap(), simapi_field_id() turns a name into its number
+// a plan lays the fields out in the order given, each aligned to its size like the members of a C struct
+// returns NULL for an unknown field
+typedef struct SimFieldPlan SimFieldPlan;
+int simapi_field_id(const char* name);
+SimFieldPlan* simapi_field_plan(const int* ids, int count);
+SimFieldPlan* simapi_field_plan_names(const char** names, int count);
+size_t simapi_field_plan_size(const SimFieldPlan* plan);
+size_t simapi_field_plan_offset(const SimFieldPlan* plan, int index);
+void simapi_field_plan_free(SimFieldPlan* plan);
+int simapi_read_fields(SimMap* simmap, const SimFieldPlan* plan, void* dst);
+// safe to call from another thread than the one mapping, each counter is read whole
+void simapi_snapshot_stats(SimMap* simmap, SimSnapshotStats* stats);
+uint64_t simapi_monotonic_ns(void);
+void simapi_source_time(SimMap* simmap, uint64_t ns);
+void simapi_frame_times(SimMap* simmap, SimFrameTimes* times);
+void simapi_set_frame_times(SimMap* simmap, const SimFrameTimes* times);
+void simapi_latency_add(SimLatencyHistogram* h, uint64_t ns);
+uint64_t simapi_latency_percentile(const SimLatencyHistogram* h, double percentile);
+int simapi_wait_for_frame(SimMap* simmap, int timeout_ms);
+int simapi_frame_fd(SimMap* simmap);
+void simapi_frame_fd_close(SimMap* simmap);
 int opensimmap(SimMap* simmap);
+int opensimsegment(SimMap* simmap, SimApiSegment segment);
+int simsegmentmap(SimMap* simmap, SimData* simdata);
+int simapi_open_segment(SimMap* simmap, SimApiSegment segment);
+int simapi_read_hot(SimMap* simmap, SimDataHot* hot);
+int simapi_read_cold(SimMap* simmap, SimDataCold* cold);
+void simapi_split_hot(const SimData* simdata, SimDataHot* hot);
+void simapi_split_cold(const SimData* simdata, SimDataCold* cold);
+// leaves the name ids and the string table alone, simcarnamesmap() publishes names that changed
+void simapi_split_cars(const SimData* simdata, SimDataCars* cars);
+int simcarnamesmap(SimMap* simmap, SimData* simdata);
+// copies the string table too when names is true, otherwise stops before it
+int simapi_read_cars(SimMap* simmap, SimDataCars* cars, bool names);
+int opensimring(SimMap* simmap, uint32_t slots);
+int simringmap(SimMap* simmap, SimData* simdata);
+int simapi_open_ring(SimMap* simmap);
+int simapi_read_ring(SimMap* simmap, uint64_t* last, SimRingFrame* frames, int max);
 int freesimmap(SimMap* simmap, bool issimd);
 int opensimcompatmap(SimCompatMap* compatmap);
 int freesimcompatmap(SimCompatMap* compatmap);
 int simcompatmapclear(SimCompatMap* compatmap);
 
+// the k closest cars to the player, nearest first, as radius and theta in pd
+// xpos/ypos are one array per axis like SimDataCars, k is at most MAXCARS
+// returns how many of pd were filled and zeroes the rest
+int simapi_proximity(const SimProximityQuery* q, const double* xpos, const double* ypos, int cars, ProximityData* pd, int k);
+// how many of SimData.pd simapi_set_proximity_data() fills for the sim mapped with simmap, at most PROXCARS, and how far out it looks
+void simapi_set_proximity(SimMap* simmap, int cars, double radius);
+// how far apart, in metres, two cars can be and still be in each other's neighbour lists in the
+// SIMAPI.CARS that simmap publishes, 0 for no lists
+void simapi_set_neighbours(SimMap* simmap, double radius);
+// the radar around cars[self] with simmap's settings, self is -1 when the player is not among cars
+void simapi_set_proximity_data(SimData* simdata, SimMap* simmap, int cars, int self, int8_t lr_flip);
+// the radar around cars[0], PROXCARS cars within SIMAPI_PROXIMITY_RADIUS
 void SetProximityData(SimData* simdata, int cars, int8_t lr_flip);
 
 void map_assetto_corsa_data(SimData* simdata, SimMap* simmap, SimulatorEXE simexe);
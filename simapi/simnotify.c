@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simnotify.h"
+
+// how often the notifier thread checks whether it should exit
+#define SIMNOTIFY_THREAD_TIMEOUT_MS 250
+
+static long futex(const uint32_t* uaddr, int op, uint32_t val, const struct timespec* timeout)
+{
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+void simnotify_wake(uint32_t* word)
+{
+    // not FUTEX_PRIVATE_FLAG, the waiters live in other processes
+    futex(word, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+int simnotify_wait(const uint32_t* word, uint32_t* seen, int timeout_ms)
+{
+    int64_t deadline = monotonic_ms() + timeout_ms;
+
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+        if ((seq & 1) == 0 && seq != *seen)
+        {
+            *seen = seq;
+            return 0;
+        }
+
+        struct timespec ts;
+        struct timespec* tsp = NULL;
+        if (timeout_ms >= 0)
+        {
+            int64_t remaining = deadline - monotonic_ms();
+            if (remaining <= 0)
+            {
+                return -1;
+            }
+            ts.tv_sec = remaining / 1000;
+            ts.tv_nsec = (remaining % 1000) * 1000000;
+            tsp = &ts;
+        }
+
+        // returns straight away with EAGAIN if the word already moved on
+        if (futex(word, FUTEX_WAIT, seq, tsp) == -1 && errno == ETIMEDOUT)
+        {
+            return -1;
+        }
+    }
+}
+
+int simapi_wait_for_frame(SimMap* simmap, int timeout_ms)
+{
+    if (simmap->sync == NULL)
+    {
+        // older daemon, all we can do is sleep
+        if (timeout_ms > 0)
+        {
+            usleep(timeout_ms * 1000);
+        }
+        return SIMAPI_ERROR_NODATA;
+    }
+
+    if (simnotify_wait(&simmap->sync->sequence, &simmap->seen_sequence, timeout_ms) != 0)
+    {
+        return SIMAPI_ERROR_NODATA;
+    }
+    return SIMAPI_ERROR_NONE;
+}
+
+static void* simnotify_thread(void* arg)
+{
+    SimMap* simmap = arg;
+    uint32_t seen = __atomic_load_n(&simmap->sync->sequence, __ATOMIC_ACQUIRE);
+    uint64_t one = 1;
+
+    while (__atomic_load_n(&simmap->notify_running, __ATOMIC_ACQUIRE) == true)
+    {
+        if (simnotify_wait(&simmap->sync->sequence, &seen, SIMNOTIFY_THREAD_TIMEOUT_MS) == 0)
+        {
+            // EAGAIN only when the counter is about to overflow, the fd is
+            // readable then anyway, anything else and the fd is no use
+            if (write(simmap->notify_fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+int simapi_frame_fd(SimMap* simmap)
+{
+    if (simmap->notify_fd >= 0)
+    {
+        return simmap->notify_fd;
+    }
+    if (simmap->sync == NULL)
+    {
+        return -1;
+    }
+
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    simmap->notify_fd = fd;
+    simmap->notify_running = true;
+    if (pthread_create(&simmap->notify_thread, NULL, simnotify_thread, simmap) != 0)
+    {
+        simmap->notify_running = false;
+        simmap->notify_fd = -1;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void simapi_frame_fd_close(SimMap* simmap)
+{
+    if (simmap->notify_fd < 0)
+    {
+        return;
+    }
+
+    __atomic_store_n(&simmap->notify_running, false, __ATOMIC_RELEASE);
+    pthread_join(simmap->notify_thread, NULL);
+    close(simmap->notify_fd);
+    simmap->notify_fd = -1;
+}
@@ -0,0 +1,13 @@
+#ifndef _SIMNOTIFY_H
+#define _SIMNOTIFY_H
+
+#include <stdint.h>
+
+// wakes every process blocked on a sequence word in a shared mapping
+void simnotify_wake(uint32_t* word);
+
+// blocks until *word is even and differs from *seen, then stores it in *seen
+// returns 0 on a new value, -1 on timeout, timeout_ms < 0 waits forever
+int simnotify_wait(const uint32_t* word, uint32_t* seen, int timeout_ms);
+
+#endif
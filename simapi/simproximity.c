@@ -0,0 +1,466 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simproximity.h"
+
+// most cells along either side of the neighbour grid
+#define NEIGHBOUR_GRID 32
+// cars further out than this are not on any track, and their cells would overflow
+#define NEIGHBOUR_MAX_COORDINATE 1e9
+
+typedef struct
+{
+    int car;
+    double d2; // squared distance to the player, or to the car whose neighbours these are
+}
+ProximityCandidate;
+
+static inline void proximity_keep(ProximityCandidate* out, int* n, int car, double d2, int self)
+{
+    if (car != self)
+    {
+        out[*n].car = car;
+        out[*n].d2 = d2;
+        (*n)++;
+    }
+}
+
+// cars from car on, the part the vector loops left over
+static int proximity_cull_tail(const double* xpos, const double* ypos, int car, int cars, double px, double py, double maxd2, int self, ProximityCandidate* out, int n)
+{
+    for (; car < cars; car++)
+    {
+        double dx = xpos[car] - px;
+        double dy = ypos[car] - py;
+        double d2 = dx * dx + dy * dy;
+        if (d2 < maxd2)
+        {
+            proximity_keep(out, &n, car, d2, self);
+        }
+    }
+    return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// built for AVX2 whatever the compiler flags, and only called where the cpu has it
+__attribute__((target("avx2")))
+static int proximity_cull_avx2(const double* xpos, const double* ypos, int cars, double px, double py, double maxd2, int self, ProximityCandidate* out)
+{
+    int n = 0;
+    int car = 0;
+    const __m256d x4 = _mm256_set1_pd(px);
+    const __m256d y4 = _mm256_set1_pd(py);
+    const __m256d max4 = _mm256_set1_pd(maxd2);
+    for (; car + 4 <= cars; car += 4)
+    {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xpos + car), x4);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ypos + car), y4);
+        __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        // ordered compare, a car at NaN is never close
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(d2, max4, _CMP_LT_OQ));
+        if (mask != 0)
+        {
+            double lane[4];
+            _mm256_storeu_pd(lane, d2);
+            for (int i = 0; i < 4; i++)
+            {
+                if (mask & (1 << i))
+                {
+                    proximity_keep(out, &n, car + i, lane[i], self);
+                }
+            }
+        }
+    }
+    return proximity_cull_tail(xpos, ypos, car, cars, px, py, maxd2, self, out, n);
+}
+
+__attribute__((target("sse2")))
+static int proximity_cull_sse2(const double* xpos, const double* ypos, int cars, double px, double py, double maxd2, int self, ProximityCandidate* out)
+{
+    int n = 0;
+    int car = 0;
+    const __m128d x2 = _mm_set1_pd(px);
+    const __m128d y2 = _mm_set1_pd(py);
+    const __m128d max2 = _mm_set1_pd(maxd2);
+    for (; car + 2 <= cars; car += 2)
+    {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(xpos + car), x2);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(ypos + car), y2);
+        __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        int mask = _mm_movemask_pd(_mm_cmplt_pd(d2, max2));
+        if (mask != 0)
+        {
+            double lane[2];
+            _mm_storeu_pd(lane, d2);
+            for (int i = 0; i < 2; i++)
+            {
+                if (mask & (1 << i))
+                {
+                    proximity_keep(out, &n, car + i, lane[i], self);
+                }
+            }
+        }
+    }
+    return proximity_cull_tail(xpos, ypos, car, cars, px, py, maxd2, self, out, n);
+}
+#endif
+
+// every car closer than sqrt(maxd2), by squared distance so that no car needs
+// a sqrt or an angle until it is known to be one of the closest few
+// the widest vectors the cpu running us has, not the ones the build assumed
+static int proximity_cull(const double* xpos, const double* ypos, int cars, double px, double py, double maxd2, int self, ProximityCandidate* out)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return proximity_cull_avx2(xpos, ypos, cars, px, py, maxd2, self, out);
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return proximity_cull_sse2(xpos, ypos, cars, px, py, maxd2, self, out);
+    }
+#endif
+    return proximity_cull_tail(xpos, ypos, 0, cars, px, py, maxd2, self, out, 0);
+}
+
+// keeps the k nearest of c[0, n) in c[0, kept), nearest first, c[0, kept) is already sorted
+// k is a handful, so a sorted insert beats a heap, and once k are kept most
+// candidates lose to the farthest of them in one compare
+static int proximity_select(ProximityCandidate* c, int kept, int n, int k)
+{
+    for (int i = kept; i < n; i++)
+    {
+        if (kept == k && c[i].d2 >= c[k - 1].d2)
+        {
+            continue;
+        }
+        ProximityCandidate t = c[i];
+        int j = kept < k ? kept++ : k - 1;
+        // equal distances keep the lower car first
+        while (j > 0 && t.d2 < c[j - 1].d2)
+        {
+            c[j] = c[j - 1];
+            j--;
+        }
+        c[j] = t;
+    }
+    return kept;
+}
+
+// the k nearest of c[0, m) sorted into c[0, k), for when m can be a whole pack
+// of cars, quickselect so only k of them go through the sorted insert
+static int proximity_nearest(ProximityCandidate* c, int m, int k)
+{
+    int lo = 0;
+    int hi = m - 1;
+    while (m > k && lo < hi)
+    {
+        double pivot = c[lo + (hi - lo) / 2].d2;
+        int i = lo;
+        int j = hi;
+        while (i <= j)
+        {
+            while (c[i].d2 < pivot)
+            {
+                i++;
+            }
+            while (c[j].d2 > pivot)
+            {
+                j--;
+            }
+            if (i <= j)
+            {
+                ProximityCandidate t = c[i];
+                c[i] = c[j];
+                c[j] = t;
+                i++;
+                j--;
+            }
+        }
+        // c[lo, j] are no further than the pivot, c[i, hi] no nearer
+        if (k - 1 <= j)
+        {
+            hi = j;
+        }
+        else if (k - 1 >= i)
+        {
+            lo = i;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return proximity_select(c, 0, m < k ? m : k, k);
+}
+
+int simapi_proximity(const SimProximityQuery* q, const double* xpos, const double* ypos, int cars, ProximityData* pd, int k)
+{
+    if (k > MAXCARS)
+    {
+        k = MAXCARS;
+    }
+
+    int kept = 0;
+    double reach = q->radius + q->carwidth;
+    if (k > 0 && reach > 0)
+    {
+        // culled a MAXCARS block at a time after the ones kept so far
+        ProximityCandidate c[MAXCARS * 2];
+        for (int first = 0; first < cars; first += MAXCARS)
+        {
+            int block = cars - first < MAXCARS ? cars - first : MAXCARS;
+            int n = proximity_cull(xpos + first, ypos + first, block, q->x, q->y, reach * reach, q->self - first, c + kept);
+            for (int i = kept; i < kept + n; i++)
+            {
+                c[i].car += first;
+            }
+            kept = proximity_select(c, kept, kept + n, k);
+        }
+
+        // theta is measured from the direction of travel, cos and sin of
+        // atan2(-1, 0) - atan2(vy, vx) straight from the velocity
+        double speed = sqrt(q->vx * q->vx + q->vy * q->vy);
+        double cosTheta = 0.0;
+        double sinTheta = -1.0;
+        if (speed > 0)
+        {
+            cosTheta = -q->vy / speed;
+            sinTheta = -q->vx / speed;
+        }
+
+        for (int i = 0; i < kept; i++)
+        {
+            double rawXCoordinate = xpos[c[i].car] - q->x;
+            double rawYCoordinate = ypos[c[i].car] - q->y;
+
+            double xscore = cosTheta * rawXCoordinate - sinTheta * rawYCoordinate;
+            double yscore = sinTheta * rawXCoordinate + cosTheta * rawYCoordinate;
+
+            double degrees = (atan2(yscore, xscore * q->lr_flip) * (180 / M_PI)) + 90.0;
+            if (degrees < 0)
+            {
+                degrees = 360 + degrees;
+            }
+
+            pd[i].radius = sqrt(c[i].d2) - q->carwidth;
+            pd[i].theta = degrees;
+            pd[i].lap = 0;
+        }
+    }
+
+    for (int i = kept; i < k; i++)
+    {
+        pd[i].radius = 0.0;
+        pd[i].theta = 0.0;
+        pd[i].lap = 0;
+    }
+    return kept;
+}
+
+void simapi_set_proximity(SimMap* simmap, int cars, double radius)
+{
+    if (cars < 0)
+    {
+        cars = 0;
+    }
+    if (cars > PROXCARS)
+    {
+        cars = PROXCARS;
+    }
+    simmap->proximity_cars = cars;
+    simmap->proximity_radius = radius;
+}
+
+static void proximity_fill(SimData* simdata, int cars, int self, int8_t lr_flip, int k, double radius)
+{
+    if (cars > MAXCARS)
+    {
+        cars = MAXCARS;
+    }
+
+    // slots past k stay empty
+    for (int x = 0; x < PROXCARS; x++)
+    {
+        simdata->pd[x].radius = 0.0;
+        simdata->pd[x].theta = 0.0;
+    }
+    // parked or crawling, there is no direction of travel to measure theta from
+    if (fabs(simdata->Yvelocity) < 1.0 && fabs(simdata->Xvelocity) < 1.0)
+    {
+        return;
+    }
+
+    // the mappers fill one CarData per car, the cull wants one array per axis
+    double xpos[MAXCARS];
+    double ypos[MAXCARS];
+    for (int car = 0; car < cars; car++)
+    {
+        xpos[car] = simdata->cars[car].xpos;
+        ypos[car] = simdata->cars[car].ypos;
+    }
+
+    SimProximityQuery q =
+    {
+        .x = simdata->worldposx,
+        .y = simdata->worldposy,
+        .vx = simdata->worldXvelocity,
+        .vy = simdata->worldYvelocity,
+        .radius = radius,
+        .carwidth = SIMAPI_PROXIMITY_CARWIDTH,
+        .self = self,
+        .lr_flip = lr_flip,
+    };
+    simapi_proximity(&q, xpos, ypos, cars, simdata->pd, k);
+}
+
+void simapi_set_proximity_data(SimData* simdata, SimMap* simmap, int cars, int self, int8_t lr_flip)
+{
+    proximity_fill(simdata, cars, self, lr_flip, simmap->proximity_cars, simmap->proximity_radius);
+}
+
+// the radar as it was before simapi_set_proximity(), the player is cars[0]
+void SetProximityData(SimData* simdata, int cars, int8_t lr_flip)
+{
+    proximity_fill(simdata, cars, 0, lr_flip, PROXCARS, SIMAPI_PROXIMITY_RADIUS);
+}
+
+void simapi_set_neighbours(SimMap* simmap, double radius)
+{
+    simmap->neighbour_radius = radius > 0 ? radius : 0;
+}
+
+void simproximity_neighbours(const SimData* simdata, double radius, SimNeighbourLists* lists)
+{
+    const CarData* cars = simdata->cars;
+    int n = simdata->numcars < MAXCARS ? simdata->numcars : MAXCARS;
+    double r = radius;
+    lists->radius = r;
+    memset(lists->neighbours, 0, sizeof(lists->neighbours));
+    if (r <= 0 || n < 2)
+    {
+        return;
+    }
+
+    double minx = INFINITY;
+    double miny = INFINITY;
+    double maxx = -INFINITY;
+    double maxy = -INFINITY;
+    bool ongrid[MAXCARS];
+    for (int i = 0; i < n; i++)
+    {
+        double x = cars[i].xpos;
+        double y = cars[i].ypos;
+        // false for NaN as well
+        ongrid[i] = fabs(x) < NEIGHBOUR_MAX_COORDINATE && fabs(y) < NEIGHBOUR_MAX_COORDINATE
+                    && cars[i].ingarage == 0;
+        if (ongrid[i] == true)
+        {
+            minx = x < minx ? x : minx;
+            miny = y < miny ? y : miny;
+            maxx = x > maxx ? x : maxx;
+            maxy = y > maxy ? y : maxy;
+        }
+    }
+    if (minx > maxx)
+    {
+        return;
+    }
+
+    // cells at least r wide, so every car within r of a car is in one of the 9
+    // cells around it, and wider on a big track so the grid stays small
+    double cell = r;
+    double extent = maxx - minx > maxy - miny ? maxx - minx : maxy - miny;
+    if (extent / cell > NEIGHBOUR_GRID)
+    {
+        cell = extent / NEIGHBOUR_GRID;
+    }
+    double cellsper = 1.0 / cell;
+    int w = (int) ((maxx - minx) * cellsper) + 1;
+    int h = (int) ((maxy - miny) * cellsper) + 1;
+
+    // counting sort by cell, positions copied alongside, so the 3 cells of
+    // one row of the 9 are one run of memory
+    uint16_t start[(NEIGHBOUR_GRID + 1) * (NEIGHBOUR_GRID + 1) + 1];
+    uint16_t fill[(NEIGHBOUR_GRID + 1) * (NEIGHBOUR_GRID + 1)];
+    uint16_t cellof[MAXCARS];
+    memset(start, 0, (w * h + 1) * sizeof(start[0]));
+    for (int i = 0; i < n; i++)
+    {
+        if (ongrid[i] == true)
+        {
+            int gx = (int) ((cars[i].xpos - minx) * cellsper);
+            int gy = (int) ((cars[i].ypos - miny) * cellsper);
+            // rounding at the far edge
+            gx = gx < w ? gx : w - 1;
+            gy = gy < h ? gy : h - 1;
+            cellof[i] = gy * w + gx;
+            start[cellof[i] + 1]++;
+        }
+    }
+    for (int g = 0; g < w * h; g++)
+    {
+        start[g + 1] += start[g];
+        fill[g] = start[g];
+    }
+
+    int ongridcars = start[w * h];
+    uint8_t sortedcar[MAXCARS];
+    double sortedx[MAXCARS];
+    double sortedy[MAXCARS];
+    for (int i = 0; i < n; i++)
+    {
+        if (ongrid[i] == true)
+        {
+            int k = fill[cellof[i]]++;
+            sortedcar[k] = i;
+            sortedx[k] = cars[i].xpos;
+            sortedy[k] = cars[i].ypos;
+        }
+    }
+
+    double r2 = r * r;
+    ProximityCandidate c[MAXCARS];
+    for (int s = 0; s < ongridcars; s++)
+    {
+        int i = sortedcar[s];
+        int gx = cellof[i] % w;
+        int gy = cellof[i] / w;
+        int x0 = gx > 0 ? gx - 1 : 0;
+        int x1 = gx < w - 1 ? gx + 1 : w - 1;
+        int y0 = gy > 0 ? gy - 1 : 0;
+        int y1 = gy < h - 1 ? gy + 1 : h - 1;
+
+        int m = 0;
+        for (int gy2 = y0; gy2 <= y1; gy2++)
+        {
+            for (int k = start[gy2 * w + x0]; k < start[gy2 * w + x1 + 1]; k++)
+            {
+                double dx = sortedx[k] - sortedx[s];
+                double dy = sortedy[k] - sortedy[s];
+                double d2 = dx * dx + dy * dy;
+                // written every time and only kept when close, whether a
+                // car is close is too unpredictable to branch on
+                c[m].car = sortedcar[k];
+                c[m].d2 = d2;
+                m += (d2 < r2) & (k != s);
+            }
+        }
+
+        int kept = proximity_nearest(c, m, SIMAPI_CAR_NEIGHBOURS);
+        for (int k = 0; k < kept; k++)
+        {
+            lists->neighbour[i][k] = c[k].car;
+        }
+        lists->neighbours[i] = kept;
+    }
+}
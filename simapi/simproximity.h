@@ -0,0 +1,21 @@
+#ifndef _SIMPROXIMITY_H
+#define _SIMPROXIMITY_H
+
+#include "simdata.h"
+
+// the neighbour lists of SIMAPI.CARS, built before the segment's write section
+// so readers only wait for the copy, not for the grid
+typedef struct
+{
+    double radius;
+    uint8_t neighbours[MAXCARS];
+    uint8_t neighbour[MAXCARS][SIMAPI_CAR_NEIGHBOURS]; // only the first neighbours[i] are set
+}
+SimNeighbourLists;
+
+// lists every car's nearest neighbours from its xpos and ypos on a uniform grid
+// with cells at least radius wide, so each car only looks at the cars in its
+// own and the 8 surrounding cells, see simapi_set_neighbours()
+void simproximity_neighbours(const SimData* simdata, double radius, SimNeighbourLists* lists);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simseqlock.h"
+#include "simnotify.h"
+#include "simlatency.h"
+#include "test.h"
+
+// every slot is its own little seqlock: simd zeroes frame, writes the slot and
+// then stores the frame number, a reader keeps a copy only if frame was the
+// number it wanted both before and after copying
+// sync->frames is the newest complete frame, sync->sequence only exists so
+// simapi_wait_for_frame() and simapi_frame_fd() work on the ring as well
+
+static SimRingFrame* ring_slot(SimMap* simmap, uint64_t frame)
+{
+    const SimRingHeader* h = simmap->addr;
+    return (SimRingFrame*) ((char*) simmap->addr + SIMAPI_RING_SLOTS_OFFSET) + (frame - 1) % h->slots;
+}
+
+int opensimring(SimMap* simmap, uint32_t slots)
+{
+    if (slots < 2)
+    {
+        return 1;
+    }
+
+    simmap->segment = SIMAPI_SEGMENT_RING;
+    simmap->fd = shm_open(SIMAPI_RING_FILE, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (simmap->fd == -1)
+    {
+        return 10;
+    }
+    // frame numbers carry on from the last simd, a slot only ever holds the frame its number says
+    if (ftruncate(simmap->fd, SIMAPI_RING_MEM_SIZE(slots)) == -1)
+    {
+        return 20;
+    }
+
+    void* addr = mmap(NULL, SIMAPI_RING_MEM_SIZE(slots), PROT_READ | PROT_WRITE, MAP_SHARED, simmap->fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        return 30;
+    }
+    simmap->addr = addr;
+    simmap->size = SIMAPI_RING_MEM_SIZE(slots);
+    simmap->sync = (SimDataSync*) ((char*) addr + SIMAPI_RING_SYNC_OFFSET);
+
+    SimRingHeader* h = addr;
+    h->slots = slots;
+    h->slotsize = sizeof(SimRingFrame);
+    __atomic_store_n(&h->version, SIMAPI_RING_VERSION, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int simringmap(SimMap* simmap, SimData* simdata)
+{
+    uint64_t frame = simmap->sync->frames + 1;
+    SimRingFrame* slot = ring_slot(simmap, frame);
+
+    simseqlock_write_begin(&simmap->sync->sequence);
+    __atomic_store_n(&slot->frame, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->sourcetime = simmap->times.source != 0 ? simmap->times.source : simapi_monotonic_ns();
+    slot->mtick = simdata->mtick;
+
+    slot->simstatus = simdata->simstatus;
+    slot->velocity = simdata->velocity;
+    slot->rpms = simdata->rpms;
+    slot->gear = simdata->gear;
+
+    slot->Xvelocity = simdata->Xvelocity;
+    slot->Yvelocity = simdata->Yvelocity;
+    slot->Zvelocity = simdata->Zvelocity;
+    slot->worldXvelocity = simdata->worldXvelocity;
+    slot->worldYvelocity = simdata->worldYvelocity;
+    slot->worldZvelocity = simdata->worldZvelocity;
+
+    slot->heading = simdata->heading;
+    slot->pitch = simdata->pitch;
+    slot->roll = simdata->roll;
+    slot->worldposx = simdata->worldposx;
+    slot->worldposy = simdata->worldposy;
+    slot->worldposz = simdata->worldposz;
+
+    slot->gas = simdata->gas;
+    slot->brake = simdata->brake;
+    slot->clutch = simdata->clutch;
+    slot->steer = simdata->steer;
+
+    memcpy(slot->tyreRPS, simdata->tyreRPS, sizeof(slot->tyreRPS));
+    memcpy(slot->suspension, simdata->suspension, sizeof(slot->suspension));
+    memcpy(slot->suspvelocity, simdata->suspvelocity, sizeof(slot->suspvelocity));
+
+    __atomic_store_n(&slot->frame, frame, __ATOMIC_RELEASE);
+    __atomic_store_n(&simmap->sync->frames, frame, __ATOMIC_RELEASE);
+    simlatency_publish(simmap);
+    simseqlock_write_end(&simmap->sync->sequence);
+    simnotify_wake(&simmap->sync->sequence);
+    return 0;
+}
+
+int simapi_open_ring(SimMap* simmap)
+{
+    if (simmap->hasSimApiDat == true)
+    {
+        return 0;
+    }
+
+    simmap->segment = SIMAPI_SEGMENT_RING;
+    simmap->fd = shm_open(SIMAPI_RING_FILE, O_RDONLY, S_IRUSR | S_IWUSR);
+    if (simmap->fd == -1)
+    {
+        return 10;
+    }
+
+    SimRingHeader h;
+    struct stat st;
+    if (fstat(simmap->fd, &st) == -1 || (size_t) st.st_size < SIMAPI_RING_SLOTS_OFFSET
+            || pread(simmap->fd, &h, sizeof(h), 0) != sizeof(h)
+            || h.version != SIMAPI_RING_VERSION || h.slotsize != sizeof(SimRingFrame) || h.slots < 2
+            || (size_t) st.st_size < SIMAPI_RING_MEM_SIZE(h.slots))
+    {
+        close(simmap->fd);
+        simmap->fd = -1;
+        return 20;
+    }
+
+    simmap->addr = mmap(NULL, SIMAPI_RING_MEM_SIZE(h.slots), PROT_READ, MAP_SHARED, simmap->fd, 0);
+    if (simmap->addr == MAP_FAILED)
+    {
+        return 30;
+    }
+    simmap->size = SIMAPI_RING_MEM_SIZE(h.slots);
+    simmap->sync = (SimDataSync*) ((char*) simmap->addr + SIMAPI_RING_SYNC_OFFSET);
+    simmap->hasSimApiDat = true;
+    return 0;
+}
+
+int simapi_read_ring(SimMap* simmap, uint64_t* last, SimRingFrame* frames, int max)
+{
+    if (simmap->sync == NULL || simmap->segment != SIMAPI_SEGMENT_RING)
+    {
+        return -1;
+    }
+
+    // a simd started since with a different ring size, open it again
+    const SimRingHeader* h = simmap->addr;
+    if (SIMAPI_RING_MEM_SIZE(h->slots) != simmap->size)
+    {
+        return -1;
+    }
+
+    uint64_t newest = __atomic_load_n(&simmap->sync->frames, __ATOMIC_ACQUIRE);
+    if (newest < *last)
+    {
+        // the ring file was removed and simd started over
+        *last = 0;
+    }
+
+    // the oldest slot may be the one simd is writing next, so start one after it
+    uint64_t first = *last + 1;
+    if (newest >= h->slots && first < newest - h->slots + 2)
+    {
+        first = newest - h->slots + 2;
+    }
+
+    int n = 0;
+    for (uint64_t frame = first; frame <= newest && n < max; frame++)
+    {
+        const SimRingFrame* slot = ring_slot(simmap, frame);
+        *last = frame;
+        if (__atomic_load_n(&slot->frame, __ATOMIC_ACQUIRE) != frame)
+        {
+            continue;
+        }
+        memcpy(&frames[n], slot, sizeof(SimRingFrame));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->frame, __ATOMIC_RELAXED) != frame)
+        {
+            // lapped while copying, the reader is a whole ring behind
+            continue;
+        }
+        n++;
+    }
+    return n;
+}
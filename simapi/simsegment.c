@@ -0,0 +1,415 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simseqlock.h"
+#include "simnotify.h"
+#include "simsegment.h"
+#include "simlatency.h"
+#include "simproximity.h"
+#include "simstrings.h"
+#include "test.h"
+
+const char* simsegment_file(SimApiSegment segment)
+{
+    switch ( segment )
+    {
+        case SIMAPI_SEGMENT_HOT :
+            return SIMAPI_HOT_FILE;
+        case SIMAPI_SEGMENT_COLD :
+            return SIMAPI_COLD_FILE;
+        case SIMAPI_SEGMENT_RING :
+            return SIMAPI_RING_FILE;
+        case SIMAPI_SEGMENT_CARS :
+            return SIMAPI_CARS_FILE;
+        default:
+            return SIMAPI_MEM_FILE;
+    }
+}
+
+static size_t segment_sync_offset(SimApiSegment segment)
+{
+    if (segment == SIMAPI_SEGMENT_HOT)
+    {
+        return SIMAPI_SEGMENT_SYNC_OFFSET(SimDataHot);
+    }
+    if (segment == SIMAPI_SEGMENT_CARS)
+    {
+        return SIMAPI_SEGMENT_SYNC_OFFSET(SimDataCars);
+    }
+    return SIMAPI_SEGMENT_SYNC_OFFSET(SimDataCold);
+}
+
+static size_t segment_mem_size(SimApiSegment segment)
+{
+    if (segment == SIMAPI_SEGMENT_HOT)
+    {
+        return SIMAPI_SEGMENT_MEM_SIZE(SimDataHot);
+    }
+    if (segment == SIMAPI_SEGMENT_CARS)
+    {
+        return SIMAPI_SEGMENT_MEM_SIZE(SimDataCars);
+    }
+    return SIMAPI_SEGMENT_MEM_SIZE(SimDataCold);
+}
+
+void simapi_split_hot(const SimData* simdata, SimDataHot* hot)
+{
+    hot->mtick = simdata->mtick;
+
+    hot->simstatus = simdata->simstatus;
+    hot->velocity = simdata->velocity;
+    hot->rpms = simdata->rpms;
+    hot->gear = simdata->gear;
+    hot->maxrpm = simdata->maxrpm;
+    hot->idlerpm = simdata->idlerpm;
+    hot->maxgears = simdata->maxgears;
+    hot->altitude = simdata->altitude;
+
+    hot->Xvelocity = simdata->Xvelocity;
+    hot->Yvelocity = simdata->Yvelocity;
+    hot->Zvelocity = simdata->Zvelocity;
+    hot->worldXvelocity = simdata->worldXvelocity;
+    hot->worldYvelocity = simdata->worldYvelocity;
+    hot->worldZvelocity = simdata->worldZvelocity;
+
+    hot->gas = simdata->gas;
+    hot->brake = simdata->brake;
+    hot->fuel = simdata->fuel;
+    hot->fuelcapacity = simdata->fuelcapacity;
+    hot->clutch = simdata->clutch;
+    hot->steer = simdata->steer;
+    hot->handbrake = simdata->handbrake;
+
+    hot->turboboost = simdata->turboboost;
+    hot->turboboostperct = simdata->turboboostperct;
+    hot->maxturbo = simdata->maxturbo;
+
+    hot->abs = simdata->abs;
+    hot->brakebias = simdata->brakebias;
+    memcpy(hot->tyreRPS, simdata->tyreRPS, sizeof(hot->tyreRPS));
+    memcpy(hot->tyrediameter, simdata->tyrediameter, sizeof(hot->tyrediameter));
+
+    hot->heading = simdata->heading;
+    hot->pitch = simdata->pitch;
+    hot->roll = simdata->roll;
+    hot->worldposx = simdata->worldposx;
+    hot->worldposy = simdata->worldposy;
+    hot->worldposz = simdata->worldposz;
+
+    memcpy(hot->braketemp, simdata->braketemp, sizeof(hot->braketemp));
+    memcpy(hot->tyrewear, simdata->tyrewear, sizeof(hot->tyrewear));
+    memcpy(hot->tyretemp, simdata->tyretemp, sizeof(hot->tyretemp));
+    memcpy(hot->tyrepressure, simdata->tyrepressure, sizeof(hot->tyrepressure));
+
+    memcpy(hot->tyrecontact0, simdata->tyrecontact0, sizeof(hot->tyrecontact0));
+    memcpy(hot->tyrecontact1, simdata->tyrecontact1, sizeof(hot->tyrecontact1));
+    memcpy(hot->tyrecontact2, simdata->tyrecontact2, sizeof(hot->tyrecontact2));
+
+    memcpy(hot->suspension, simdata->suspension, sizeof(hot->suspension));
+    memcpy(hot->suspvelocity, simdata->suspvelocity, sizeof(hot->suspvelocity));
+
+    hot->playerspline = simdata->playerspline;
+
+    hot->simexe = simdata->simexe;
+    hot->simapi = simdata->simapi;
+    hot->simon = simdata->simon;
+    hot->simapiversion = simdata->simapiversion;
+    memcpy(hot->gearc, simdata->gearc, sizeof(hot->gearc));
+}
+
+void simapi_split_cold(const SimData* simdata, SimDataCold* cold)
+{
+    cold->mtick = simdata->mtick;
+
+    cold->lap = simdata->lap;
+    cold->position = simdata->position;
+    cold->numlaps = simdata->numlaps;
+    cold->playerlaps = simdata->playerlaps;
+    cold->numcars = simdata->numcars;
+
+    cold->distance = simdata->distance;
+    cold->airdensity = simdata->airdensity;
+    cold->airtemp = simdata->airtemp;
+    cold->tracktemp = simdata->tracktemp;
+    cold->trackdistancearound = simdata->trackdistancearound;
+    cold->trackspline = simdata->trackspline;
+    cold->playertrackpos = simdata->playertrackpos;
+    cold->tracksamples = simdata->tracksamples;
+
+    cold->lastlap = simdata->lastlap;
+    cold->bestlap = simdata->bestlap;
+    cold->currentlap = simdata->currentlap;
+    cold->currentlapinseconds = simdata->currentlapinseconds;
+    cold->lastlapinseconds = simdata->lastlapinseconds;
+    cold->time = simdata->time;
+    cold->sessiontime = simdata->sessiontime;
+    cold->session = simdata->session;
+    cold->sectorindex = simdata->sectorindex;
+    cold->sector1time = simdata->sector1time;
+    cold->sector2time = simdata->sector2time;
+    cold->lastsectorinms = simdata->lastsectorinms;
+    cold->courseflag = simdata->courseflag;
+    cold->playerflag = simdata->playerflag;
+
+    cold->lapisvalid = simdata->lapisvalid;
+
+    memcpy(cold->car, simdata->car, sizeof(cold->car));
+    memcpy(cold->track, simdata->track, sizeof(cold->track));
+    memcpy(cold->driver, simdata->driver, sizeof(cold->driver));
+    memcpy(cold->tyrecompound, simdata->tyrecompound, sizeof(cold->tyrecompound));
+
+    memcpy(cold->cars, simdata->cars, sizeof(cold->cars));
+    memcpy(cold->pd, simdata->pd, sizeof(cold->pd));
+}
+
+// one pass over the cars, each CarData is read once and its fields go to their arrays
+void simapi_split_cars(const SimData* simdata, SimDataCars* cars)
+{
+    const CarData* c = simdata->cars;
+
+    cars->mtick = simdata->mtick;
+    cars->numcars = simdata->numcars < MAXCARS ? simdata->numcars : MAXCARS;
+
+    for (int i = 0; i < MAXCARS; i++)
+    {
+        cars->xpos[i] = c[i].xpos;
+        cars->ypos[i] = c[i].ypos;
+        cars->zpos[i] = c[i].zpos;
+        cars->carspline[i] = c[i].carspline;
+        cars->speed[i] = c[i].speed;
+        cars->pos[i] = c[i].pos;
+        cars->lap[i] = c[i].lap;
+        cars->trackpos[i] = c[i].trackpos;
+        cars->pitflags[i] = (c[i].inpit ? SIMAPI_CAR_INPIT : 0)
+                            | (c[i].inpitlane ? SIMAPI_CAR_INPITLANE : 0)
+                            | (c[i].ingarage ? SIMAPI_CAR_INGARAGE : 0)
+                            | (c[i].inpitentrance ? SIMAPI_CAR_INPITENTRANCE : 0)
+                            | (c[i].inpitexit ? SIMAPI_CAR_INPITEXIT : 0)
+                            | (c[i].inpitstopped ? SIMAPI_CAR_INPITSTOPPED : 0);
+    }
+}
+
+static inline bool split_name_changed(const SimDataCars* cars, uint16_t id, const char* name)
+{
+    return strncmp(cars->strings[id], name, SIMAPI_STRING_SIZE - 1) != 0;
+}
+
+// a name that changed gets the id of its new string, interning it if no one had it yet
+static void split_name(SimMap* simmap, uint16_t* id, const char* name, bool* added)
+{
+    SimDataCars* cars = simmap->addr;
+    if (split_name_changed(cars, *id, name) == true)
+    {
+        *id = simstrings_intern(&simmap->strings, cars, name, added);
+    }
+}
+
+// comparing 260 names costs more than the rest of SIMAPI.CARS, so simd does it at the cold rate
+int simcarnamesmap(SimMap* simmap, SimData* simdata)
+{
+    SimDataCars* cars = simmap->addr;
+
+    bool changed = split_name_changed(cars, cars->trackid, simdata->track)
+                   || split_name_changed(cars, cars->playercarid, simdata->car)
+                   || split_name_changed(cars, cars->playerdriverid, simdata->driver)
+                   || split_name_changed(cars, cars->compoundid, simdata->tyrecompound);
+    for (int i = 0; i < MAXCARS && changed == false; i++)
+    {
+        changed = split_name_changed(cars, cars->driverid[i], simdata->cars[i].driver)
+                  || split_name_changed(cars, cars->carid[i], simdata->cars[i].car);
+    }
+    if (changed == false)
+    {
+        return 0;
+    }
+
+    simseqlock_write_begin(&simmap->sync->sequence);
+    bool added = false;
+    split_name(simmap, &cars->trackid, simdata->track, &added);
+    split_name(simmap, &cars->playercarid, simdata->car, &added);
+    split_name(simmap, &cars->playerdriverid, simdata->driver, &added);
+    split_name(simmap, &cars->compoundid, simdata->tyrecompound, &added);
+    for (int i = 0; i < MAXCARS; i++)
+    {
+        split_name(simmap, &cars->driverid[i], simdata->cars[i].driver, &added);
+        split_name(simmap, &cars->carid[i], simdata->cars[i].car, &added);
+    }
+    // a car only swapping to a name already in the table leaves the table as it was
+    if (added == true)
+    {
+        cars->namesgeneration++;
+    }
+    simmap->sync->frames++;
+    simlatency_publish(simmap);
+    simseqlock_write_end(&simmap->sync->sequence);
+    simnotify_wake(&simmap->sync->sequence);
+    return 0;
+}
+
+int opensimsegment(SimMap* simmap, SimApiSegment segment)
+{
+    simmap->segment = segment;
+    simmap->fd = shm_open(simsegment_file(segment), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (simmap->fd == -1)
+    {
+        return 10;
+    }
+    if (ftruncate(simmap->fd, segment_mem_size(segment)) == -1)
+    {
+        return 20;
+    }
+
+    void* addr = mmap(NULL, segment_mem_size(segment), PROT_READ | PROT_WRITE, MAP_SHARED, simmap->fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        return 30;
+    }
+    simmap->addr = addr;
+    simmap->size = segment_mem_size(segment);
+    simmap->sync = (SimDataSync*) ((char*) addr + segment_sync_offset(segment));
+
+    if (segment == SIMAPI_SEGMENT_CARS)
+    {
+        // a table left by the last simd does not match this one's index
+        SimDataCars* cars = addr;
+        simseqlock_write_begin(&simmap->sync->sequence);
+        simstrings_reset(&simmap->strings, cars);
+        cars->namesgeneration++;
+        simseqlock_write_end(&simmap->sync->sequence);
+    }
+    return 0;
+}
+
+static void split_neighbours(const SimNeighbourLists* lists, SimDataCars* cars)
+{
+    cars->neighbourradius = lists->radius;
+    memcpy(cars->neighbours, lists->neighbours, sizeof(cars->neighbours));
+    for (int i = 0; i < MAXCARS; i++)
+    {
+        memcpy(cars->neighbour[i], lists->neighbour[i], lists->neighbours[i]);
+    }
+}
+
+int simsegmentmap(SimMap* simmap, SimData* simdata)
+{
+    SimNeighbourLists lists;
+    if (simmap->segment == SIMAPI_SEGMENT_CARS)
+    {
+        simproximity_neighbours(simdata, simmap->neighbour_radius, &lists);
+    }
+
+    simseqlock_write_begin(&simmap->sync->sequence);
+    if (simmap->segment == SIMAPI_SEGMENT_HOT)
+    {
+        simapi_split_hot(simdata, simmap->addr);
+    }
+    else if (simmap->segment == SIMAPI_SEGMENT_CARS)
+    {
+        simapi_split_cars(simdata, simmap->addr);
+        split_neighbours(&lists, simmap->addr);
+    }
+    else
+    {
+        simapi_split_cold(simdata, simmap->addr);
+    }
+    simmap->sync->frames++;
+    simlatency_publish(simmap);
+    simseqlock_write_end(&simmap->sync->sequence);
+    simnotify_wake(&simmap->sync->sequence);
+    return 0;
+}
+
+int simapi_open_segment(SimMap* simmap, SimApiSegment segment)
+{
+    if (simmap->hasSimApiDat == true)
+    {
+        return 0;
+    }
+
+    simmap->segment = segment;
+    simmap->fd = shm_open(simsegment_file(segment), O_RDONLY, S_IRUSR | S_IWUSR);
+    if (simmap->fd == -1)
+    {
+        return 10;
+    }
+
+    struct stat st;
+    if (fstat(simmap->fd, &st) == -1 || (size_t) st.st_size < segment_mem_size(segment))
+    {
+        close(simmap->fd);
+        simmap->fd = -1;
+        return 20;
+    }
+
+    simmap->addr = mmap(NULL, segment_mem_size(segment), PROT_READ, MAP_SHARED, simmap->fd, 0);
+    if (simmap->addr == MAP_FAILED)
+    {
+        return 30;
+    }
+    simmap->size = segment_mem_size(segment);
+    simmap->sync = (SimDataSync*) ((char*) simmap->addr + segment_sync_offset(segment));
+    simmap->hasSimApiDat = true;
+    return 0;
+}
+
+static int read_segment(SimMap* simmap, SimApiSegment segment, void* dst, size_t size)
+{
+    if (simmap->sync == NULL || simmap->segment != segment)
+    {
+        return SIMAPI_ERROR_NODATA;
+    }
+
+    SimFrameTimes times;
+    for (int tries = 0; tries < SIMSEQLOCK_MAX_RETRIES; tries++)
+    {
+        uint32_t seq = simseqlock_read_begin(&simmap->sync->sequence);
+        if ((seq & 1) == 0)
+        {
+            memcpy(dst, simmap->addr, size);
+            simlatency_load(simmap, &times);
+            if (simseqlock_read_retry(&simmap->sync->sequence, seq) == false)
+            {
+                simlatency_read(simmap, &times);
+                return SIMAPI_ERROR_NONE;
+            }
+        }
+
+        if (tries < SIMSEQLOCK_SPINS_BEFORE_YIELD)
+        {
+            simseqlock_relax();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return SIMAPI_ERROR_BUSY;
+}
+
+int simapi_read_hot(SimMap* simmap, SimDataHot* hot)
+{
+    return read_segment(simmap, SIMAPI_SEGMENT_HOT, hot, sizeof(SimDataHot));
+}
+
+int simapi_read_cold(SimMap* simmap, SimDataCold* cold)
+{
+    return read_segment(simmap, SIMAPI_SEGMENT_COLD, cold, sizeof(SimDataCold));
+}
+
+int simapi_read_cars(SimMap* simmap, SimDataCars* cars, bool names)
+{
+    return read_segment(simmap, SIMAPI_SEGMENT_CARS, cars, names == true ? sizeof(SimDataCars) : offsetof(SimDataCars, strings));
+}
@@ -0,0 +1,8 @@
+#ifndef _SIMSEGMENT_H
+#define _SIMSEGMENT_H
+
+#include "simmapper.h"
+
+const char* simsegment_file(SimApiSegment segment);
+
+#endif
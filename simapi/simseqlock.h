@@ -0,0 +1,47 @@
+#ifndef _SIMSEQLOCK_H
+#define _SIMSEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// single writer sequence lock used for everything simd publishes to /dev/shm
+// the writer makes the sequence odd, writes, then makes it even again
+// readers copy out and retry if the sequence was odd or moved underneath them
+
+#define SIMSEQLOCK_SPINS_BEFORE_YIELD 64
+#define SIMSEQLOCK_MAX_RETRIES 4096
+
+static inline void simseqlock_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline void simseqlock_write_begin(uint32_t* seq)
+{
+    uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    __atomic_store_n(seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void simseqlock_write_end(uint32_t* seq)
+{
+    uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    __atomic_store_n(seq, s + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t simseqlock_read_begin(const uint32_t* seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static inline bool simseqlock_read_retry(const uint32_t* seq, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+#endif
@@ -0,0 +1,305 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sched.h>
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simseqlock.h"
+#include "simsnapshot.h"
+
+#include "../include/acdata.h"
+#include "../include/rf2data.h"
+#include "../include/pcars2data.h"
+
+static int load_int(const void* addr)
+{
+    return __atomic_load_n((const int*) addr, __ATOMIC_ACQUIRE);
+}
+
+static int clamp_vehicles(int n, int max)
+{
+    if (n < 0)
+    {
+        return 0;
+    }
+    if (n > max)
+    {
+        return max;
+    }
+    return n;
+}
+
+static void snapshot_backoff(int tries)
+{
+    if (tries < 4)
+    {
+        simseqlock_relax();
+    }
+    else
+    {
+        sched_yield();
+    }
+}
+
+static void snapshot_done(SimMap* simmap, int tries)
+{
+    // simapi_snapshot_stats() may be reading these from another thread
+    SimSnapshotStats* st = &simmap->snapshot;
+    __atomic_store_n(&st->reads, st->reads + 1, __ATOMIC_RELAXED);
+    if (tries > 0)
+    {
+        __atomic_store_n(&st->torn, st->torn + tries, __ATOMIC_RELAXED);
+    }
+    if (tries >= SIMSNAPSHOT_MAX_RETRIES)
+    {
+        // keep going with the last copy rather than stall the mapping loop
+        __atomic_store_n(&st->failed, st->failed + 1, __ATOMIC_RELAXED);
+    }
+}
+
+// the rF2 plugin increments mVersionUpdateBegin before writing a buffer and
+// sets mVersionUpdateEnd to match once it is done, only the vehicles in use are
+// copied and only buffers whose mVersionUpdateEnd moved since the last copy,
+// telemetry_fresh and scoring_fresh say which ones were
+void simsnapshot_rf2(SimMap* simmap)
+{
+    RF2Map* rf2 = &simmap->rf2;
+    char* a = rf2->telemetry_map_addr;
+    struct rF2Telemetry* t = &rf2->rf2_telemetry;
+    int tries;
+
+    rf2->telemetry_fresh = false;
+    rf2->scoring_fresh = false;
+
+    // the copy from last time is still whole while the plugin writes the next one
+    if (rf2->telemetry_copied == false || load_int(a + offsetof(struct rF2Telemetry, mVersionUpdateEnd)) != rf2->telemetry_version)
+    {
+        for (tries = 0; tries < SIMSNAPSHOT_MAX_RETRIES; tries++)
+        {
+            int begin = load_int(a + offsetof(struct rF2Telemetry, mVersionUpdateBegin));
+            int end = load_int(a + offsetof(struct rF2Telemetry, mVersionUpdateEnd));
+            if (begin == end)
+            {
+                int n = clamp_vehicles(load_int(a + offsetof(struct rF2Telemetry, mNumVehicles)), RF2_MAX_VEHICLES);
+                memcpy(t, a, offsetof(struct rF2Telemetry, mVehicles) + (sizeof(rF2VehicleTelemetry) * n));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (load_int(a + offsetof(struct rF2Telemetry, mVersionUpdateBegin)) == begin)
+                {
+                    rf2->telemetry_version = end;
+                    break;
+                }
+            }
+            snapshot_backoff(tries);
+        }
+        snapshot_done(simmap, tries);
+        // a torn copy is still mapped, but copied again next frame
+        rf2->telemetry_copied = tries < SIMSNAPSHOT_MAX_RETRIES;
+        rf2->telemetry_fresh = true;
+    }
+
+    if (rf2->has_scoring == false)
+    {
+        rf2->scoring_copied = false;
+        return;
+    }
+
+    char* b = rf2->scoring_map_addr;
+    struct rF2Scoring* s = &rf2->rf2_scoring;
+    if (rf2->scoring_copied == false || load_int(b + offsetof(struct rF2Scoring, mVersionUpdateEnd)) != rf2->scoring_version)
+    {
+        for (tries = 0; tries < SIMSNAPSHOT_MAX_RETRIES; tries++)
+        {
+            int begin = load_int(b + offsetof(struct rF2Scoring, mVersionUpdateBegin));
+            int end = load_int(b + offsetof(struct rF2Scoring, mVersionUpdateEnd));
+            if (begin == end)
+            {
+                int n = clamp_vehicles(load_int(b + offsetof(struct rF2Scoring, mScoringInfo) + offsetof(rF2ScoringInfo, mNumVehicles)), RF2_MAX_VEHICLES);
+                memcpy(s, b, offsetof(struct rF2Scoring, mVehicles) + (sizeof(rF2VehicleScoring) * n));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (load_int(b + offsetof(struct rF2Scoring, mVersionUpdateBegin)) == begin)
+                {
+                    rf2->scoring_version = end;
+                    break;
+                }
+            }
+            snapshot_backoff(tries);
+        }
+        snapshot_done(simmap, tries);
+        rf2->scoring_copied = tries < SIMSNAPSHOT_MAX_RETRIES;
+        rf2->scoring_fresh = true;
+    }
+}
+
+// mSequenceNumber is odd while the game is writing
+void simsnapshot_pcars2(SimMap* simmap)
+{
+    char* a = simmap->pcars2.telemetry_map_addr;
+    int tries;
+
+    for (tries = 0; tries < SIMSNAPSHOT_MAX_RETRIES; tries++)
+    {
+        uint32_t seq = simseqlock_read_begin((const uint32_t*) (a + offsetof(struct pcars2APIStruct, mSequenceNumber)));
+        if ((seq & 1) == 0)
+        {
+            memcpy(&simmap->pcars2.pcars2_telemetry, a, sizeof(struct pcars2APIStruct));
+            if (simseqlock_read_retry((const uint32_t*) (a + offsetof(struct pcars2APIStruct, mSequenceNumber)), seq) == false)
+            {
+                break;
+            }
+        }
+        snapshot_backoff(tries);
+    }
+    snapshot_done(simmap, tries);
+}
+
+// AC has no write-in-progress marker, but a packetId that moved during the
+// copy means the page was rewritten underneath us, a packetId that has not
+// moved since the last good copy means there is nothing new to copy
+static bool snapshot_ac_page(SimMap* simmap, void* dst, const char* src, size_t size, size_t packetid, bool* copied, int* packet)
+{
+    if (*copied == true && load_int(src + packetid) == *packet)
+    {
+        return false;
+    }
+
+    int tries;
+    for (tries = 0; tries < SIMSNAPSHOT_MAX_RETRIES; tries++)
+    {
+        int id = load_int(src + packetid);
+        memcpy(dst, src, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (load_int(src + packetid) == id)
+        {
+            *packet = id;
+            break;
+        }
+        snapshot_backoff(tries);
+    }
+    snapshot_done(simmap, tries);
+    *copied = tries < SIMSNAPSHOT_MAX_RETRIES;
+    return true;
+}
+
+static uint64_t snapshot_hash(const unsigned char* p, size_t size)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static void snapshot_ac_static(SimMap* simmap)
+{
+    ACMap* ac = &simmap->ac;
+    ac->static_fresh = false;
+    if (ac->has_static == false)
+    {
+        ac->static_copied = false;
+        return;
+    }
+
+    // without a graphics page there is no session to watch, hash every time
+    // a car or track change the graphics page does not show is caught by the
+    // restarted packetId of a new session or by the once a second hash
+    int status = ac->has_graphic == true ? ac->ac_graphic.status : -1;
+    int session = ac->has_graphic == true ? ac->ac_graphic.session : -1;
+    int packet = ac->has_graphic == true ? ac->ac_graphic.packetId : -1;
+    uint64_t now = simapi_monotonic_ns();
+    if (ac->static_copied == true && ac->has_graphic == true && status == ac->static_status && session == ac->static_session
+        && packet >= ac->static_packet && now - ac->static_hashed < SIMSNAPSHOT_STATIC_NS)
+    {
+        ac->static_packet = packet;
+        return;
+    }
+    ac->static_status = status;
+    ac->static_session = session;
+    ac->static_packet = packet;
+    ac->static_hashed = now;
+
+    uint64_t h = snapshot_hash(ac->static_map_addr, sizeof(struct SPageFileStatic));
+    if (ac->static_copied == true && h == ac->static_hash)
+    {
+        return;
+    }
+    memcpy(&ac->ac_static, ac->static_map_addr, sizeof(struct SPageFileStatic));
+    ac->static_hash = h;
+    ac->static_copied = true;
+    ac->static_fresh = true;
+}
+
+static void snapshot_ac_crewchief(SimMap* simmap, bool wanted)
+{
+    ACMap* ac = &simmap->ac;
+    ac->crewchief_fresh = false;
+    if (ac->has_crewchief == false || wanted == false)
+    {
+        ac->crewchief_copied = false;
+        return;
+    }
+
+    // the plugin writes the cars from the same game frame as the graphics page,
+    // so with a graphics page there is nothing new until its packetId moves
+    if (ac->has_graphic == true && ac->graphic_fresh == false && ac->crewchief_copied == true)
+    {
+        return;
+    }
+
+    const char* src = ac->crewchief_map_addr;
+    char* dst = (char*) &ac->ac_crewchief;
+    int n = clamp_vehicles(load_int(src + offsetof(struct SPageFileCrewChief, numVehicles)), AC_MAX_VEHICLES);
+    size_t size = offsetof(struct SPageFileCrewChief, vehicle) + (sizeof(acsVehicleInfo) * n);
+    if (ac->has_graphic == false && ac->crewchief_copied == true && memcmp(dst, src, size) == 0)
+    {
+        return;
+    }
+
+    int tries;
+    for (tries = 0; tries < SIMSNAPSHOT_MAX_RETRIES; tries++)
+    {
+        memcpy(dst, src, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // a copy whose numVehicles moved on has the wrong number of cars in it
+        if (clamp_vehicles(ac->ac_crewchief.numVehicles, AC_MAX_VEHICLES) == n && memcmp(dst, src, size) == 0)
+        {
+            break;
+        }
+        snapshot_backoff(tries);
+        n = clamp_vehicles(load_int(src + offsetof(struct SPageFileCrewChief, numVehicles)), AC_MAX_VEHICLES);
+        size = offsetof(struct SPageFileCrewChief, vehicle) + (sizeof(acsVehicleInfo) * n);
+    }
+    snapshot_done(simmap, tries);
+    ac->crewchief_copied = tries < SIMSNAPSHOT_MAX_RETRIES;
+    ac->crewchief_fresh = true;
+}
+
+void simsnapshot_ac(SimMap* simmap, bool crewchief)
+{
+    ACMap* ac = &simmap->ac;
+    ac->physics_fresh = snapshot_ac_page(simmap, &ac->ac_physics, ac->physics_map_addr, sizeof(struct SPageFilePhysics), offsetof(struct SPageFilePhysics, packetId),
+                                         &ac->physics_copied, &ac->physics_packet);
+    ac->graphic_fresh = false;
+    if (ac->has_graphic == true)
+    {
+        ac->graphic_fresh = snapshot_ac_page(simmap, &ac->ac_graphic, ac->graphic_map_addr, sizeof(struct SPageFileGraphic), offsetof(struct SPageFileGraphic, packetId),
+                                             &ac->graphic_copied, &ac->graphic_packet);
+    }
+    else
+    {
+        ac->graphic_copied = false;
+    }
+    snapshot_ac_static(simmap);
+    snapshot_ac_crewchief(simmap, crewchief);
+}
+
+void simapi_snapshot_stats(SimMap* simmap, SimSnapshotStats* stats)
+{
+    stats->reads = __atomic_load_n(&simmap->snapshot.reads, __ATOMIC_RELAXED);
+    stats->torn = __atomic_load_n(&simmap->snapshot.torn, __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&simmap->snapshot.failed, __ATOMIC_RELAXED);
+}
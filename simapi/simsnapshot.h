@@ -0,0 +1,19 @@
+#ifndef _SIMSNAPSHOT_H
+#define _SIMSNAPSHOT_H
+
+#include "simmap.h"
+
+// copy the source's shared memory into the private buffers in SimMap,
+// retrying while the sim's own counters show a write in progress
+// mappers then read rf2_telemetry, ac_physics etc. instead of the mapping
+
+#define SIMSNAPSHOT_MAX_RETRIES 16
+// the AC static page is hashed at least this often, see ACMap
+#define SIMSNAPSHOT_STATIC_NS 1000000000ull
+
+void simsnapshot_rf2(SimMap* simmap);
+void simsnapshot_pcars2(SimMap* simmap);
+// crewchief is false for sims that never map the crewchief page (ACC)
+void simsnapshot_ac(SimMap* simmap, bool crewchief);
+
+#endif
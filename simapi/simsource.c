@@ -0,0 +1,614 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "simdata.h"
+#include "simapi.h"
+#include "simmapper.h"
+#include "simmap.h"
+#include "simsource.h"
+
+#define SIMSOURCE_FILE_BUFFER (1024 * 1024)
+// bytes of records the capturing thread can be ahead of the writer before frames are dropped
+#define SIMSOURCE_RING_SIZE (16 * 1024 * 1024)
+#define SIMSOURCE_FLUSH_MS 10
+
+struct SimSourceFile
+{
+    FILE* file;
+    bool writing;
+    SimulatorAPI simulator;
+    SimulatorEXE simexe;
+    uint64_t first;
+    bool started;
+
+    // capture: what each page held last time, replay: the page itself
+    void* pages[SIMSOURCE_MAX_PAGES];
+    size_t sizes[SIMSOURCE_MAX_PAGES];
+    uint32_t sincekey;
+
+    uint8_t* scratch;
+    size_t scratchsize;
+    char* dgram;
+
+    // capture: records are built on the capturing thread and written to the
+    // file by the writer, so a slow disk never holds up a frame
+    uint8_t* ring;
+    uint64_t head; // written by the capturing thread
+    uint64_t tail; // written by the writer
+    uint64_t frames;
+    uint64_t dropped;
+    bool failed; // set by the writer at the first failed write
+    bool running;
+    bool threaded;
+    pthread_t thread;
+};
+
+static uint64_t simsource_clock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// where a sim's source page is read from when capturing, and where its
+// mapping address points when replaying
+typedef struct
+{
+    const void* src;
+    void** addr;
+    bool* has;
+    size_t size;
+}
+SimSourcePageMap;
+
+static int simsource_pages(SimMap* simmap, SimulatorAPI simulator, SimSourcePageMap* pages)
+{
+    // rF2, AC physics and graphics and PCars2 are captured from the snapshot
+    // the mapper just took, the rest straight from the mapping
+    switch (simulator)
+    {
+        case SIMULATORAPI_RFACTOR2:
+            pages[0] = (SimSourcePageMap) { &simmap->rf2.rf2_telemetry, &simmap->rf2.telemetry_map_addr, &simmap->rf2.has_telemetry, sizeof(simmap->rf2.rf2_telemetry) };
+            pages[1] = (SimSourcePageMap) { &simmap->rf2.rf2_scoring, &simmap->rf2.scoring_map_addr, &simmap->rf2.has_scoring, sizeof(simmap->rf2.rf2_scoring) };
+            return 2;
+        case SIMULATORAPI_ASSETTO_CORSA:
+            pages[0] = (SimSourcePageMap) { &simmap->ac.ac_physics, &simmap->ac.physics_map_addr, &simmap->ac.has_physics, sizeof(simmap->ac.ac_physics) };
+            pages[1] = (SimSourcePageMap) { &simmap->ac.ac_graphic, &simmap->ac.graphic_map_addr, &simmap->ac.has_graphic, sizeof(simmap->ac.ac_graphic) };
+            pages[2] = (SimSourcePageMap) { simmap->ac.static_map_addr, &simmap->ac.static_map_addr, &simmap->ac.has_static, sizeof(simmap->ac.ac_static) };
+            pages[3] = (SimSourcePageMap) { simmap->ac.crewchief_map_addr, &simmap->ac.crewchief_map_addr, &simmap->ac.has_crewchief, sizeof(simmap->ac.ac_crewchief) };
+            return 4;
+        case SIMULATORAPI_PROJECTCARS2:
+            pages[0] = (SimSourcePageMap) { &simmap->pcars2.pcars2_telemetry, &simmap->pcars2.telemetry_map_addr, &simmap->pcars2.has_telemetry, sizeof(simmap->pcars2.pcars2_telemetry) };
+            return 1;
+        case SIMULATORAPI_SCSTRUCKSIM2:
+            pages[0] = (SimSourcePageMap) { simmap->scs2.telemetry_map_addr, &simmap->scs2.telemetry_map_addr, &simmap->scs2.has_telemetry, sizeof(simmap->scs2.scs2_telemetry) };
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static size_t simsource_varint(uint8_t* out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+static int simsource_read_varint(const uint8_t** p, const uint8_t* end, uint64_t* v)
+{
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7)
+    {
+        uint8_t c = *(*p)++;
+        *v |= (uint64_t) (c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint64_t simsource_word(const uint8_t* p, size_t i, size_t size)
+{
+    uint64_t w = 0;
+    size_t n = size - (i * 8) < 8 ? size - (i * 8) : 8;
+    memcpy(&w, p + (i * 8), n);
+    return w;
+}
+
+// the page as runs of 8 byte words: varint(unchanged words), varint(changed
+// words), then the changed words xor their previous value, the last word of
+// the page only as long as the page
+static size_t simsource_encode(const uint8_t* cur, const uint8_t* prev, size_t size, uint8_t* out)
+{
+    size_t words = (size + 7) / 8;
+    size_t len = 0;
+    size_t i = 0;
+    while (i < words)
+    {
+        size_t same = i;
+        while (same < words && simsource_word(cur, same, size) == simsource_word(prev, same, size))
+        {
+            same++;
+        }
+        if (same == words)
+        {
+            break;
+        }
+        size_t diff = same;
+        while (diff < words && simsource_word(cur, diff, size) != simsource_word(prev, diff, size))
+        {
+            diff++;
+        }
+
+        len += simsource_varint(out + len, same - i);
+        len += simsource_varint(out + len, diff - same);
+        for (size_t w = same; w < diff; w++)
+        {
+            uint64_t x = simsource_word(cur, w, size) ^ simsource_word(prev, w, size);
+            size_t n = size - (w * 8) < 8 ? size - (w * 8) : 8;
+            memcpy(out + len, &x, n);
+            len += n;
+        }
+        i = diff;
+    }
+    return len;
+}
+
+static int simsource_decode(uint8_t* page, size_t size, const uint8_t* p, const uint8_t* end)
+{
+    size_t words = (size + 7) / 8;
+    size_t w = 0;
+    while (p < end)
+    {
+        uint64_t same;
+        uint64_t diff;
+        if (simsource_read_varint(&p, end, &same) != 0 || simsource_read_varint(&p, end, &diff) != 0)
+        {
+            return -1;
+        }
+        w += same;
+        if (w + diff > words)
+        {
+            return -1;
+        }
+        for (uint64_t k = 0; k < diff; k++, w++)
+        {
+            size_t n = size - (w * 8) < 8 ? size - (w * 8) : 8;
+            if (p + n > end)
+            {
+                return -1;
+            }
+            for (size_t b = 0; b < n; b++)
+            {
+                page[(w * 8) + b] ^= p[b];
+            }
+            p += n;
+        }
+    }
+    return 0;
+}
+
+static void simsource_free(SimSourceFile* f)
+{
+    if (f->file != NULL)
+    {
+        fclose(f->file);
+    }
+    for (int i = 0; i < SIMSOURCE_MAX_PAGES; i++)
+    {
+        free(f->pages[i]);
+    }
+    free(f->scratch);
+    free(f->dgram);
+    free(f->ring);
+    free(f);
+}
+
+static uint64_t simsource_time(SimSourceFile* f)
+{
+    uint64_t now = simsource_clock(CLOCK_MONOTONIC);
+    if (f->started == false)
+    {
+        f->first = now;
+        f->started = true;
+    }
+    return now - f->first;
+}
+
+static void* simsource_writer(void* arg)
+{
+    SimSourceFile* f = arg;
+
+    for (;;)
+    {
+        bool running = __atomic_load_n(&f->running, __ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&f->head, __ATOMIC_ACQUIRE);
+        while (f->tail != head)
+        {
+            size_t off = f->tail % SIMSOURCE_RING_SIZE;
+            size_t n = head - f->tail < SIMSOURCE_RING_SIZE - off ? head - f->tail : SIMSOURCE_RING_SIZE - off;
+            // after a failure the records are still taken off the ring, just not written
+            if (f->failed == false && fwrite(f->ring + off, 1, n, f->file) != n)
+            {
+                __atomic_store_n(&f->failed, true, __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&f->tail, f->tail + n, __ATOMIC_RELEASE);
+        }
+        if (running == false)
+        {
+            break;
+        }
+        usleep(SIMSOURCE_FLUSH_MS * 1000);
+    }
+    return NULL;
+}
+
+static void simsource_ring_copy(SimSourceFile* f, uint64_t at, const void* src, size_t len)
+{
+    size_t off = at % SIMSOURCE_RING_SIZE;
+    size_t n = len < SIMSOURCE_RING_SIZE - off ? len : SIMSOURCE_RING_SIZE - off;
+    memcpy(f->ring + off, src, n);
+    memcpy(f->ring, (const uint8_t*) src + n, len - n);
+}
+
+// hands a record to the writer, never blocks, a record that does not fit is
+// dropped and the next page record made a keyframe, a xor against pages the
+// file never got would be no use to a replay
+static void simsource_queue(SimSourceFile* f, const SimSourceRecord* rec, const void* payload)
+{
+    uint64_t head = f->head;
+    size_t len = sizeof(SimSourceRecord) + rec->length;
+    f->frames++;
+    if (len > SIMSOURCE_RING_SIZE - (head - __atomic_load_n(&f->tail, __ATOMIC_ACQUIRE)))
+    {
+        f->dropped++;
+        f->sincekey = 0;
+        return;
+    }
+
+    simsource_ring_copy(f, head, rec, sizeof(SimSourceRecord));
+    simsource_ring_copy(f, head + sizeof(SimSourceRecord), payload, rec->length);
+    __atomic_store_n(&f->head, head + len, __ATOMIC_RELEASE);
+}
+
+SimSourceFile* simapi_capture_open(const char* path, SimulatorAPI simulator, SimulatorEXE simexe)
+{
+    SimSourceFile* f = calloc(1, sizeof(SimSourceFile));
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    f->writing = true;
+    f->simulator = simulator;
+    f->simexe = simexe;
+
+    f->file = fopen(path, "wbe");
+    if (f->file == NULL)
+    {
+        simsource_free(f);
+        return NULL;
+    }
+    setvbuf(f->file, NULL, _IOFBF, SIMSOURCE_FILE_BUFFER);
+
+    SimSourceHeader h;
+    memcpy(h.magic, SIMSOURCE_MAGIC, sizeof(h.magic));
+    h.version = SIMSOURCE_VERSION;
+    h.simulatorapi = simulator;
+    h.simulatorexe = simexe;
+    h.started = simsource_clock(CLOCK_REALTIME);
+    if (fwrite(&h, sizeof(h), 1, f->file) != 1)
+    {
+        simsource_free(f);
+        return NULL;
+    }
+
+    f->ring = malloc(SIMSOURCE_RING_SIZE);
+    if (f->ring == NULL)
+    {
+        simsource_free(f);
+        return NULL;
+    }
+    f->running = true;
+    if (pthread_create(&f->thread, NULL, simsource_writer, f) != 0)
+    {
+        simsource_free(f);
+        return NULL;
+    }
+    f->threaded = true;
+    return f;
+}
+
+static int simsource_scratch(SimSourceFile* f, size_t size)
+{
+    if (f->scratchsize >= size)
+    {
+        return 0;
+    }
+    uint8_t* s = realloc(f->scratch, size);
+    if (s == NULL)
+    {
+        return -1;
+    }
+    f->scratch = s;
+    f->scratchsize = size;
+    return 0;
+}
+
+static int simsource_capture_shm(SimSourceFile* f, SimMap* simmap)
+{
+    SimSourcePageMap pages[SIMSOURCE_MAX_PAGES];
+    int n = simsource_pages(simmap, f->simulator, pages);
+
+    size_t bound = 0;
+    for (int i = 0; i < n; i++)
+    {
+        // worst case every other word changed, two one byte varints per word
+        bound += sizeof(SimSourcePage) + pages[i].size + (((pages[i].size + 7) / 8) * 2) + 20;
+    }
+    if (simsource_scratch(f, bound) != 0)
+    {
+        return SIMAPI_ERROR_UNKNOWN;
+    }
+
+    bool key = f->sincekey == 0 || f->sincekey >= SIMSOURCE_KEYFRAME_INTERVAL;
+    size_t len = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (*pages[i].has == false || pages[i].src == NULL)
+        {
+            continue;
+        }
+
+        SimSourcePage* ph = (SimSourcePage*) (f->scratch + len);
+        uint8_t* out = f->scratch + len + sizeof(SimSourcePage);
+        ph->page = i;
+        ph->encoding = SIMSOURCE_PAGE_RAW;
+        ph->length = pages[i].size;
+
+        if (key == false && f->pages[i] != NULL)
+        {
+            size_t elen = simsource_encode(pages[i].src, f->pages[i], pages[i].size, out);
+            if (elen < pages[i].size)
+            {
+                ph->encoding = SIMSOURCE_PAGE_XOR;
+                ph->length = elen;
+            }
+        }
+        if (ph->encoding == SIMSOURCE_PAGE_RAW)
+        {
+            memcpy(out, pages[i].src, pages[i].size);
+        }
+        len += sizeof(SimSourcePage) + ph->length;
+
+        if (f->pages[i] == NULL)
+        {
+            f->pages[i] = malloc(pages[i].size);
+            if (f->pages[i] == NULL)
+            {
+                return SIMAPI_ERROR_UNKNOWN;
+            }
+        }
+        memcpy(f->pages[i], pages[i].src, pages[i].size);
+    }
+    f->sincekey = key == true ? 1 : f->sincekey + 1;
+
+    SimSourceRecord rec;
+    rec.type = SIMSOURCE_RECORD_SHM;
+    rec.length = len;
+    rec.time = simsource_time(f);
+    simsource_queue(f, &rec, f->scratch);
+    return SIMAPI_ERROR_NONE;
+}
+
+int simapi_capture_frame(SimSourceFile* f, SimMap* simmap, const char* base, size_t len)
+{
+    if (__atomic_load_n(&f->failed, __ATOMIC_RELAXED) == true)
+    {
+        return SIMAPI_ERROR_UNKNOWN;
+    }
+    if (base == NULL)
+    {
+        return simsource_capture_shm(f, simmap);
+    }
+
+    SimSourceRecord rec;
+    rec.type = SIMSOURCE_RECORD_UDP;
+    rec.length = len;
+    rec.time = simsource_time(f);
+    simsource_queue(f, &rec, base);
+    return SIMAPI_ERROR_NONE;
+}
+
+void simapi_capture_stats(SimSourceFile* f, uint64_t* frames, uint64_t* dropped)
+{
+    *frames = f->frames;
+    *dropped = f->dropped;
+}
+
+void simapi_capture_close(SimSourceFile* f)
+{
+    if (f != NULL)
+    {
+        if (f->threaded == true)
+        {
+            __atomic_store_n(&f->running, false, __ATOMIC_RELEASE);
+            pthread_join(f->thread, NULL);
+        }
+        simsource_free(f);
+    }
+}
+
+SimSourceFile* simapi_replay_open(const char* path, SimulatorAPI* simulator, SimulatorEXE* simexe)
+{
+    SimSourceFile* f = calloc(1, sizeof(SimSourceFile));
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    f->file = fopen(path, "rbe");
+    f->dgram = calloc(1, SIMSOURCE_DGRAM_SIZE);
+    if (f->file == NULL || f->dgram == NULL)
+    {
+        simsource_free(f);
+        return NULL;
+    }
+    setvbuf(f->file, NULL, _IOFBF, SIMSOURCE_FILE_BUFFER);
+
+    SimSourceHeader h;
+    if (fread(&h, sizeof(h), 1, f->file) != 1 || memcmp(h.magic, SIMSOURCE_MAGIC, sizeof(h.magic)) != 0 || h.version != SIMSOURCE_VERSION)
+    {
+        simsource_free(f);
+        return NULL;
+    }
+    f->simulator = h.simulatorapi;
+    f->simexe = h.simulatorexe;
+    *simulator = f->simulator;
+    *simexe = f->simexe;
+    return f;
+}
+
+static void simsource_wait(SimSourceFile* f, uint64_t time)
+{
+    if (f->started == false)
+    {
+        f->first = simsource_clock(CLOCK_MONOTONIC) - time;
+        f->started = true;
+        return;
+    }
+    struct timespec ts;
+    uint64_t due = f->first + time;
+    ts.tv_sec = due / 1000000000;
+    ts.tv_nsec = due % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+static int simsource_replay_shm(SimSourceFile* f, SimMap* simmap, size_t len)
+{
+    SimSourcePageMap pages[SIMSOURCE_MAX_PAGES];
+    int n = simsource_pages(simmap, f->simulator, pages);
+
+    const uint8_t* p = f->scratch;
+    const uint8_t* end = f->scratch + len;
+    while (p < end)
+    {
+        SimSourcePage ph;
+        if (p + sizeof(ph) > end)
+        {
+            return SIMAPI_ERROR_UNKNOWN;
+        }
+        memcpy(&ph, p, sizeof(ph));
+        p += sizeof(ph);
+        if (ph.page >= n || p + ph.length > end)
+        {
+            return SIMAPI_ERROR_UNKNOWN;
+        }
+
+        SimSourcePageMap* pm = &pages[ph.page];
+        if (f->pages[ph.page] == NULL)
+        {
+            f->pages[ph.page] = calloc(1, pm->size);
+            if (f->pages[ph.page] == NULL)
+            {
+                return SIMAPI_ERROR_UNKNOWN;
+            }
+            f->sizes[ph.page] = pm->size;
+        }
+        if (ph.encoding == SIMSOURCE_PAGE_RAW && ph.length == pm->size)
+        {
+            memcpy(f->pages[ph.page], p, pm->size);
+        }
+        else if (ph.encoding != SIMSOURCE_PAGE_XOR || simsource_decode(f->pages[ph.page], pm->size, p, p + ph.length) != 0)
+        {
+            return SIMAPI_ERROR_UNKNOWN;
+        }
+        p += ph.length;
+
+        // the mapper reads the replayed page as if it were the sim's mapping
+        *pm->addr = f->pages[ph.page];
+        *pm->has = true;
+    }
+    return SIMAPI_ERROR_NONE;
+}
+
+int simapi_replay_frame(SimSourceFile* f, SimData* simdata, SimMap* simmap, bool realtime)
+{
+    SimSourceRecord rec;
+    if (fread(&rec, sizeof(rec), 1, f->file) != 1)
+    {
+        return SIMAPI_ERROR_NODATA;
+    }
+    if (simsource_scratch(f, rec.length) != 0 || fread(f->scratch, 1, rec.length, f->file) != rec.length)
+    {
+        return SIMAPI_ERROR_NODATA;
+    }
+
+    if (realtime == true)
+    {
+        simsource_wait(f, rec.time);
+    }
+
+    simdata->simapi = f->simulator;
+    simdata->simexe = f->simexe;
+    switch (rec.type)
+    {
+        case SIMSOURCE_RECORD_SHM:
+            if (simsource_replay_shm(f, simmap, rec.length) != SIMAPI_ERROR_NONE)
+            {
+                return SIMAPI_ERROR_UNKNOWN;
+            }
+            simdatamap(simdata, simmap, NULL, f->simulator, false, NULL);
+            break;
+        case SIMSOURCE_RECORD_UDP:
+            if (rec.length > SIMSOURCE_DGRAM_SIZE)
+            {
+                return SIMAPI_ERROR_UNKNOWN;
+            }
+            // same zeroed tail a live receive has
+            memcpy(f->dgram, f->scratch, rec.length);
+            memset(f->dgram + rec.length, 0, SIMSOURCE_DGRAM_SIZE - rec.length);
+            simdatamap(simdata, simmap, NULL, f->simulator, true, f->dgram);
+            break;
+        default:
+            return SIMAPI_ERROR_UNKNOWN;
+    }
+    return SIMAPI_ERROR_NONE;
+}
+
+void simapi_replay_close(SimSourceFile* f, SimMap* simmap)
+{
+    if (f == NULL)
+    {
+        return;
+    }
+
+    // hand the map back without the replay buffers, so simfree() does not unmap them
+    SimSourcePageMap pages[SIMSOURCE_MAX_PAGES];
+    int n = simsource_pages(simmap, f->simulator, pages);
+    for (int i = 0; i < n; i++)
+    {
+        if (f->pages[i] != NULL && *pages[i].addr == f->pages[i])
+        {
+            *pages[i].addr = NULL;
+            *pages[i].has = false;
+        }
+    }
+    simsource_free(f);
+}
@@ -0,0 +1,57 @@
+#ifndef _SIMSOURCE_H
+#define _SIMSOURCE_H
+
+#include <stdint.h>
+
+#include "simmap.h"
+
+// raw source capture, the sim's own pages or datagrams exactly as a mapper
+// saw them, so simdatamap() can be run again later without the sim
+
+#define SIMSOURCE_MAGIC "SIMSRC\0\1"
+#define SIMSOURCE_VERSION 1
+
+#define SIMSOURCE_RECORD_SHM 1 // one page record per source page the sim has
+#define SIMSOURCE_RECORD_UDP 2 // one datagram
+
+#define SIMSOURCE_PAGE_RAW 0
+#define SIMSOURCE_PAGE_XOR 1 // runs against the previous copy of the page
+
+#define SIMSOURCE_MAX_PAGES 4
+#define SIMSOURCE_KEYFRAME_INTERVAL 600
+// replayed datagrams sit in a zeroed buffer this big, like simd's receive pool
+#define SIMSOURCE_DGRAM_SIZE 65536
+
+#pragma pack(push)
+#pragma pack(1)
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t simulatorapi;
+    uint64_t simulatorexe;
+    uint64_t started; // unix time in ns
+}
+SimSourceHeader;
+
+typedef struct
+{
+    uint8_t type;
+    uint32_t length; // of everything after this header
+    uint64_t time; // ns since the first record
+}
+SimSourceRecord;
+
+// inside a SIMSOURCE_RECORD_SHM, followed by length bytes
+typedef struct
+{
+    uint8_t page;
+    uint8_t encoding;
+    uint32_t length;
+}
+SimSourcePage;
+
+#pragma pack(pop)
+
+#endif
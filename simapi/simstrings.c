@@ -0,0 +1,120 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "simdata.h"
+#include "simstrings.h"
+
+// FNV-1a over as much of s as fits in the table
+static uint32_t simstrings_hash(const char* s)
+{
+    uint32_t h = 2166136261u;
+    for (int k = 0; k < SIMAPI_STRING_SIZE - 1 && s[k] != '\0'; k++)
+    {
+        h = (h ^ (uint8_t) s[k]) * 16777619u;
+    }
+    return h;
+}
+
+static void simstrings_insert(SimStrings* st, const SimDataCars* cars, uint16_t id)
+{
+    uint32_t h = simstrings_hash(cars->strings[id]) & (SIMSTRINGS_INDEX - 1);
+    while (st->index[h] != 0)
+    {
+        h = (h + 1) & (SIMSTRINGS_INDEX - 1);
+    }
+    st->index[h] = id + 1;
+}
+
+void simstrings_reset(SimStrings* st, SimDataCars* cars)
+{
+    memset(cars->strings, 0, sizeof(cars->strings));
+    memset(cars->driverid, 0, sizeof(cars->driverid));
+    memset(cars->carid, 0, sizeof(cars->carid));
+    cars->trackid = 0;
+    cars->playercarid = 0;
+    cars->playerdriverid = 0;
+    cars->compoundid = 0;
+
+    memset(st->index, 0, sizeof(st->index));
+    st->next = 1;
+    st->freecount = 0;
+}
+
+// the table is full, frees every id that no car and none of the player's names use
+// there are never more than 2 * MAXCARS + 4 of those, so this always frees some
+static void simstrings_reclaim(SimStrings* st, SimDataCars* cars)
+{
+    bool used[SIMAPI_STRINGS] = {false};
+    for (int i = 0; i < MAXCARS; i++)
+    {
+        used[cars->driverid[i]] = true;
+        used[cars->carid[i]] = true;
+    }
+    used[cars->trackid] = true;
+    used[cars->playercarid] = true;
+    used[cars->playerdriverid] = true;
+    used[cars->compoundid] = true;
+
+    memset(st->index, 0, sizeof(st->index));
+    st->freecount = 0;
+    // backwards, so the lowest free id is handed out first
+    for (uint16_t id = SIMAPI_STRINGS - 1; id > 0; id--)
+    {
+        if (used[id] == true)
+        {
+            simstrings_insert(st, cars, id);
+        }
+        else
+        {
+            memset(cars->strings[id], 0, SIMAPI_STRING_SIZE);
+            st->free[st->freecount++] = id;
+        }
+    }
+}
+
+uint16_t simstrings_intern(SimStrings* st, SimDataCars* cars, const char* s, bool* added)
+{
+    if (s[0] == '\0')
+    {
+        return 0;
+    }
+
+    uint32_t h = simstrings_hash(s) & (SIMSTRINGS_INDEX - 1);
+    while (st->index[h] != 0)
+    {
+        uint16_t id = st->index[h] - 1;
+        // only as much of s as the table keeps, see simstrings.h
+        if (strncmp(cars->strings[id], s, SIMAPI_STRING_SIZE - 1) == 0)
+        {
+            return id;
+        }
+        h = (h + 1) & (SIMSTRINGS_INDEX - 1);
+    }
+
+    uint16_t id;
+    if (st->next < SIMAPI_STRINGS)
+    {
+        id = st->next++;
+    }
+    else
+    {
+        if (st->freecount == 0)
+        {
+            simstrings_reclaim(st, cars);
+            // reclaiming empties strings, readers have to look again
+            *added = true;
+        }
+        if (st->freecount == 0)
+        {
+            return 0;
+        }
+        id = st->free[--st->freecount];
+    }
+
+    strncpy(cars->strings[id], s, SIMAPI_STRING_SIZE - 1);
+    cars->strings[id][SIMAPI_STRING_SIZE - 1] = '\0';
+    simstrings_insert(st, cars, id);
+    *added = true;
+    return id;
+}
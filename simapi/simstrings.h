@@ -0,0 +1,44 @@
+#ifndef _SIMSTRINGS_H
+#define _SIMSTRINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "simdata.h"
+
+// simd's side of the string table in SIMAPI.CARS, interning each name once and
+// handing out its id, called with the segment's seqlock held for writing
+// the table keeps the first SIMAPI_STRING_SIZE - 1 characters of a name, names
+// alike in those are one string and share an id
+
+// open addressing from a string's hash to its id + 1, at most a third full
+#define SIMSTRINGS_INDEX 1024
+
+// the index into one SIMAPI.CARS table, kept by the SimMap publishing it
+typedef struct
+{
+    uint16_t index[SIMSTRINGS_INDEX];
+    // ids from next up were never handed out, freed ones wait on free
+    uint16_t next;
+    uint16_t free[SIMAPI_STRINGS];
+    int freecount;
+}
+SimStrings;
+
+// empties the table and every id, for a freshly opened segment
+void simstrings_reset(SimStrings* st, SimDataCars* cars);
+// the id of s, added to the table if it is new, which sets *added
+uint16_t simstrings_intern(SimStrings* st, SimDataCars* cars, const char* s, bool* added);
+
+// a name from the sim's fixed size field into SimData, only written when it changed
+static inline void simstrings_copy(char* dst, const char* src, size_t len)
+{
+    if (memcmp(dst, src, len) != 0)
+    {
+        memcpy(dst, src, len);
+    }
+}
+
+#endif
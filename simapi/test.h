@@ -2,5 +2,9 @@
 #define _TEST_H
 
 #define SIMAPI_MEM_FILE "SIMAPI.DAT"
+#define SIMAPI_HOT_FILE "SIMAPI.HOT"
+#define SIMAPI_COLD_FILE "SIMAPI.COLD"
+#define SIMAPI_RING_FILE "SIMAPI.RING"
+#define SIMAPI_CARS_FILE "SIMAPI.CARS"
 
 #endif
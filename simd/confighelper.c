@@ -95,7 +95,7 @@ int loadconfig(SimdSettings simds, int compat_info_size, GameCompatInfo* gc)
             bridgedelay_found = config_setting_lookup_int(config_sim, "bridgedelay", &bridgedelay);
 
             gc[i].LaunchExe = strdup(launch_exe);
-            gc[i].LiveExe = strdup(live_exe);
+            gc[i].LiveExe = live_found ? strdup(live_exe) : NULL;
             gc[i].Name = strdup(sim_name);
             gc[i].BridgeDelay = bridgedelay;
             gc[i].simapi = simapi;
@@ -14,6 +14,8 @@ typedef struct
     char* LiveExe;
     int BridgeDelay;
     int simapi;
+    int LaunchScan; // procscan indexes, -1 when the exe is not set
+    int LiveScan;
 }
 GameCompatInfo;
 
@@ -26,10 +28,22 @@ typedef struct
     bool daemon;
     bool notify;
     bool bridge_path_set;
+    bool source_driven;
+    bool udp_stats;
+    bool rt;
+    int rtcpu;
+    int rtpriority;
+    int pollrate;
+    int maxrate;
+    int coldrate;
+    int history;
     char* home_dir;
     char* configfile;
     char* pokesetting;
     char* targetvalue;
+    char* recorddir;
+    char* capturedir;
+    char* metricssocket;
 }
 SimdSettings;
 
@@ -0,0 +1,314 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <uv.h>
+
+#include "metrics.h"
+
+// the Prometheus text of one SimdMetrics is well under this
+#define METRICS_TEXT_SIZE 8192
+
+typedef struct
+{
+    uv_pipe_t pipe;
+    uv_write_t req;
+    char text[METRICS_TEXT_SIZE];
+}
+MetricsClient;
+
+static bool metrics_shared = false;
+static SimdMetrics* metrics_served = NULL;
+static uv_pipe_t metrics_server;
+static bool metrics_server_open = false;
+static char* metrics_path = NULL;
+
+// udp counters of the sessions that already ended
+static UdpStats metrics_udpdone;
+static uint64_t metrics_dropsdone;
+
+static const char* metrics_simnames[SIMD_METRICS_SIMS] =
+{
+    "simapi_test", "assetto_corsa", "rfactor2", "project_cars2", "scs_trucks", "outgauge", "dirt_rally_2",
+    "f1_2018", "raceroom", "forza", "lmu", "wreckfest2", "richard_burns_rally", NULL, NULL, NULL
+};
+
+static uint64_t metrics_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+SimdMetrics* metrics_open()
+{
+    SimdMetrics* m = NULL;
+
+    int fd = shm_open(SIMD_METRICS_FILE, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd != -1)
+    {
+        if (ftruncate(fd, sizeof(SimdMetrics)) == 0)
+        {
+            void* a = mmap(NULL, sizeof(SimdMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (a != MAP_FAILED)
+            {
+                m = a;
+                metrics_shared = true;
+            }
+        }
+        close(fd);
+    }
+    if (m == NULL)
+    {
+        m = malloc(sizeof(SimdMetrics));
+        if (m == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    memset(m, 0, sizeof(SimdMetrics));
+    memset(&metrics_udpdone, 0, sizeof(metrics_udpdone));
+    metrics_dropsdone = 0;
+    m->version = SIMD_METRICS_VERSION;
+    m->size = sizeof(SimdMetrics);
+    m->started = metrics_now();
+    m->updated = m->started;
+    // last, so a reader that checks the magic finds the rest filled in
+    __atomic_store_n(&m->magic, SIMD_METRICS_MAGIC, __ATOMIC_RELEASE);
+    return m;
+}
+
+void metrics_close(SimdMetrics* m)
+{
+    if (m == NULL)
+    {
+        return;
+    }
+    if (metrics_shared == true)
+    {
+        munmap(m, sizeof(SimdMetrics));
+        shm_unlink(SIMD_METRICS_FILE);
+        metrics_shared = false;
+    }
+    else
+    {
+        free(m);
+    }
+}
+
+void metrics_frame(SimdMetrics* m, SimulatorAPI sim)
+{
+    if (sim >= 0 && sim < SIMD_METRICS_SIMS)
+    {
+        METRICS_SET(m->frames[sim], m->frames[sim] + 1);
+    }
+}
+
+void metrics_start(SimdMetrics* m, SimulatorAPI sim)
+{
+    METRICS_SET(m->sim, sim);
+    METRICS_SET(m->mapping, 1);
+    METRICS_SET(m->sessions, m->sessions + 1);
+}
+
+void metrics_refresh(SimdMetrics* m, const UdpStats* udpstats, const SimSnapshotStats* snapshot)
+{
+    const UdpStats* done = &metrics_udpdone;
+    UdpStats none = {0};
+    if (udpstats == NULL)
+    {
+        udpstats = &none;
+    }
+
+    // the mapping thread is still counting into udpstats
+    METRICS_SET(m->udppackets, done->packets + UDPSTATS_GET(udpstats->packets));
+    METRICS_SET(m->udpdropped, metrics_dropsdone + UDPSTATS_GET(udpstats->drops));
+    METRICS_SET(m->udptruncated, done->truncated + UDPSTATS_GET(udpstats->truncated));
+    METRICS_SET(m->udperrors, done->errors + UDPSTATS_GET(udpstats->errors));
+
+    // the snapshot counters already run for the life of the SimMap
+    if (snapshot != NULL)
+    {
+        METRICS_SET(m->sourcereads, snapshot->reads);
+        METRICS_SET(m->sourcetorn, snapshot->torn);
+        METRICS_SET(m->sourcefailed, snapshot->failed);
+    }
+    METRICS_SET(m->updated, metrics_now());
+}
+
+void metrics_stop(SimdMetrics* m, const UdpStats* udpstats, const SimSnapshotStats* snapshot)
+{
+    metrics_refresh(m, udpstats, snapshot);
+    if (udpstats != NULL)
+    {
+        metrics_udpdone.packets += UDPSTATS_GET(udpstats->packets);
+        metrics_udpdone.truncated += UDPSTATS_GET(udpstats->truncated);
+        metrics_udpdone.errors += UDPSTATS_GET(udpstats->errors);
+        metrics_dropsdone += UDPSTATS_GET(udpstats->drops);
+    }
+    METRICS_SET(m->mapping, 0);
+}
+
+static size_t metrics_append(char* buf, size_t len, size_t at, const char* fmt, ...)
+{
+    if (at >= len)
+    {
+        return at;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + at, len - at, fmt, args);
+    va_end(args);
+    if (n < 0)
+    {
+        return at;
+    }
+    return at + n < len ? at + n : len;
+}
+
+static size_t metrics_counter(char* buf, size_t len, size_t at, const char* name, const char* help, uint64_t value)
+{
+    at = metrics_append(buf, len, at, "# HELP simd_%s %s\n# TYPE simd_%s counter\n", name, help, name);
+    return metrics_append(buf, len, at, "simd_%s %lu\n", name, (unsigned long) value);
+}
+
+// a summary without quantiles, plus the worst case as its own gauge
+static size_t metrics_timing(char* buf, size_t len, size_t at, const char* name, const char* help, const SimdMetricsTiming* t)
+{
+    at = metrics_append(buf, len, at, "# HELP simd_%s_seconds %s\n# TYPE simd_%s_seconds summary\n", name, help, name);
+    at = metrics_append(buf, len, at, "simd_%s_seconds_sum %.9f\nsimd_%s_seconds_count %lu\n", name, METRICS_GET(t->totalns) / 1e9, name, (unsigned long) METRICS_GET(t->count));
+    at = metrics_append(buf, len, at, "# HELP simd_%s_max_seconds Longest single %s.\n# TYPE simd_%s_max_seconds gauge\n", name, name, name);
+    return metrics_append(buf, len, at, "simd_%s_max_seconds %.9f\n", name, METRICS_GET(t->maxns) / 1e9);
+}
+
+size_t metrics_format(const SimdMetrics* m, char* buf, size_t len)
+{
+    size_t at = 0;
+
+    at = metrics_append(buf, len, at, "# HELP simd_uptime_seconds Time since simd started.\n# TYPE simd_uptime_seconds gauge\n");
+    at = metrics_append(buf, len, at, "simd_uptime_seconds %.3f\n", (metrics_now() - METRICS_GET(m->started)) / 1e9);
+    at = metrics_append(buf, len, at, "# HELP simd_mapping Whether a sim is being mapped.\n# TYPE simd_mapping gauge\n");
+    uint32_t sim = METRICS_GET(m->sim);
+    if (METRICS_GET(m->mapping) != 0 && sim < SIMD_METRICS_SIMS && metrics_simnames[sim] != NULL)
+    {
+        at = metrics_append(buf, len, at, "simd_mapping{sim=\"%s\"} 1\n", metrics_simnames[sim]);
+    }
+    else
+    {
+        at = metrics_append(buf, len, at, "simd_mapping 0\n");
+    }
+    at = metrics_counter(buf, len, at, "sessions_total", "Sessions mapped.", METRICS_GET(m->sessions));
+
+    at = metrics_append(buf, len, at, "# HELP simd_frames_mapped_total Frames mapped, by sim.\n# TYPE simd_frames_mapped_total counter\n");
+    for (int i = 0; i < SIMD_METRICS_SIMS; i++)
+    {
+        uint64_t frames = METRICS_GET(m->frames[i]);
+        if (metrics_simnames[i] != NULL && frames > 0)
+        {
+            at = metrics_append(buf, len, at, "simd_frames_mapped_total{sim=\"%s\"} %lu\n", metrics_simnames[i], (unsigned long) frames);
+        }
+    }
+
+    at = metrics_timing(buf, len, at, "map", "Time in simdatamap.", &m->map);
+    at = metrics_timing(buf, len, at, "write", "Time in simdmap writing SIMAPI.DAT.", &m->write);
+    at = metrics_timing(buf, len, at, "publish", "Time publishing SIMAPI.HOT and SIMAPI.COLD.", &m->publish);
+    at = metrics_timing(buf, len, at, "jitter", "How far each fixed rate map tick was off its 16ms period.", &m->jitter);
+    at = metrics_timing(buf, len, at, "procscan", "Time scanning /proc for a sim.", &m->procscan);
+
+    at = metrics_counter(buf, len, at, "udp_packets_total", "Datagrams received.", METRICS_GET(m->udppackets));
+    at = metrics_counter(buf, len, at, "udp_dropped_total", "Datagrams the kernel dropped with the socket buffer full.", METRICS_GET(m->udpdropped));
+    at = metrics_counter(buf, len, at, "udp_late_total", "Datagrams mapped more than 2ms after they arrived.", METRICS_GET(m->udplate));
+    at = metrics_counter(buf, len, at, "udp_truncated_total", "Datagrams larger than the receive buffer.", METRICS_GET(m->udptruncated));
+    at = metrics_counter(buf, len, at, "udp_errors_total", "Receive errors.", METRICS_GET(m->udperrors));
+
+    at = metrics_counter(buf, len, at, "source_reads_total", "Copies of the sim's shared memory.", METRICS_GET(m->sourcereads));
+    at = metrics_counter(buf, len, at, "source_torn_total", "Copies retried because the sim wrote during the copy.", METRICS_GET(m->sourcetorn));
+    at = metrics_counter(buf, len, at, "source_failed_total", "Frames given up on after too many torn copies.", METRICS_GET(m->sourcefailed));
+    return at;
+}
+
+static void metrics_client_close(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static void metrics_written(uv_write_t* req, int status)
+{
+    // nothing to do about a client that went away first
+    (void) status;
+    MetricsClient* c = req->data;
+    uv_close((uv_handle_t*) &c->pipe, metrics_client_close);
+}
+
+static void metrics_connection(uv_stream_t* server, int status)
+{
+    if (status < 0)
+    {
+        return;
+    }
+
+    MetricsClient* c = malloc(sizeof(MetricsClient));
+    if (c == NULL)
+    {
+        return;
+    }
+    uv_pipe_init(server->loop, &c->pipe, 0);
+    c->pipe.data = c;
+    c->req.data = c;
+    if (uv_accept(server, (uv_stream_t*) &c->pipe) != 0)
+    {
+        uv_close((uv_handle_t*) &c->pipe, metrics_client_close);
+        return;
+    }
+
+    uv_buf_t buf = uv_buf_init(c->text, metrics_format(metrics_served, c->text, sizeof(c->text)));
+    if (uv_write(&c->req, (uv_stream_t*) &c->pipe, &buf, 1, metrics_written) != 0)
+    {
+        uv_close((uv_handle_t*) &c->pipe, metrics_client_close);
+    }
+}
+
+int metrics_serve(SimdMetrics* m, uv_loop_t* loop, const char* path)
+{
+    metrics_served = m;
+    // a socket left behind by a simd that did not get to clean up
+    unlink(path);
+
+    uv_pipe_init(loop, &metrics_server, 0);
+    metrics_server_open = true;
+    if (uv_pipe_bind(&metrics_server, path) != 0)
+    {
+        metrics_unserve();
+        return 1;
+    }
+    metrics_path = strdup(path);
+    if (uv_listen((uv_stream_t*) &metrics_server, 8, metrics_connection) != 0)
+    {
+        metrics_unserve();
+        return 2;
+    }
+    return 0;
+}
+
+void metrics_unserve()
+{
+    if (metrics_server_open == true && uv_is_closing((uv_handle_t*) &metrics_server) == 0)
+    {
+        uv_close((uv_handle_t*) &metrics_server, NULL);
+    }
+    metrics_server_open = false;
+    if (metrics_path != NULL)
+    {
+        unlink(metrics_path);
+        free(metrics_path);
+        metrics_path = NULL;
+    }
+}
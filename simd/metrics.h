@@ -0,0 +1,102 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <uv.h>
+#include <simapi.h>
+#include <simmapper.h>
+#include "udphelper.h"
+
+// simd's own counters, kept in /dev/shm/SIMD.METRICS for anything that wants to
+// watch a running daemon, and optionally served as Prometheus text on a unix
+// socket with --metrics-socket, see docs/simd_metrics.md for the layout
+
+#define SIMD_METRICS_FILE "SIMD.METRICS"
+#define SIMD_METRICS_MAGIC 0x53444d54 // "SDMT"
+#define SIMD_METRICS_VERSION 1
+
+// one frame counter per SimulatorAPI, with room to spare
+#define SIMD_METRICS_SIMS 16
+// a datagram mapped this long after the kernel received it counts as late
+#define SIMD_METRICS_LATE_NS 2000000
+#define SIMD_METRICS_REFRESH_MS 1000
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t totalns;
+    uint64_t maxns;
+}
+SimdMetricsTiming;
+
+// every field has one writer, the mapping thread or the libuv loop, and is only
+// ever stored whole with METRICS_SET(), so a reader loading it with METRICS_GET()
+// sees each counter whole but not all of them at the same instant, counters only
+// go up for the life of the daemon
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // sizeof(SimdMetrics)
+    uint32_t sim; // SimulatorAPI being mapped
+    uint32_t mapping; // 1 while a session is mapping
+    uint32_t pad;
+    uint64_t started; // CLOCK_MONOTONIC ns
+    uint64_t updated; // last refresh, CLOCK_MONOTONIC ns
+    uint64_t sessions;
+    uint64_t frames[SIMD_METRICS_SIMS]; // simdatamap() calls, by SimulatorAPI
+
+    SimdMetricsTiming map; // simdatamap(), reading the source and filling SimData
+    SimdMetricsTiming write; // simdmap(), publishing SIMAPI.DAT
+    SimdMetricsTiming publish; // SIMAPI.HOT, SIMAPI.COLD and the recorder
+    SimdMetricsTiming jitter; // how far each datamaptimer tick was off 16ms
+    SimdMetricsTiming procscan; // one walk of /proc in gamefindcallback
+
+    uint64_t udppackets;
+    uint64_t udpdropped; // by the kernel, the socket buffer was full
+    uint64_t udplate; // mapped more than SIMD_METRICS_LATE_NS after arriving
+    uint64_t udptruncated;
+    uint64_t udperrors;
+
+    uint64_t sourcereads; // snapshot copies of the sim's shared memory
+    uint64_t sourcetorn; // copies retried because the sim wrote mid copy
+    uint64_t sourcefailed; // frames given up on
+}
+SimdMetrics;
+
+#define METRICS_SET(field, v) __atomic_store_n(&(field), (v), __ATOMIC_RELAXED)
+#define METRICS_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+// maps the shared block, or falls back to private memory so the callers never
+// have to check, returns NULL only when both fail
+SimdMetrics* metrics_open();
+void metrics_close(SimdMetrics* m);
+
+// only ever called by the field's one writer, the stores are atomic for the readers
+static inline void metrics_time(SimdMetricsTiming* t, uint64_t ns)
+{
+    METRICS_SET(t->count, t->count + 1);
+    METRICS_SET(t->totalns, t->totalns + ns);
+    if (ns > t->maxns)
+    {
+        METRICS_SET(t->maxns, ns);
+    }
+}
+
+void metrics_frame(SimdMetrics* m, SimulatorAPI sim);
+void metrics_start(SimdMetrics* m, SimulatorAPI sim);
+// brings the udp and source counters up to date, udpstats and snapshot may be NULL
+void metrics_refresh(SimdMetrics* m, const UdpStats* udpstats, const SimSnapshotStats* snapshot);
+// folds this session's udp counters into the totals, udpstats is about to be cleared
+void metrics_stop(SimdMetrics* m, const UdpStats* udpstats, const SimSnapshotStats* snapshot);
+
+// Prometheus text exposition of m, returns the length written, truncated at len
+size_t metrics_format(const SimdMetrics* m, char* buf, size_t len);
+
+// serves metrics_format() to every connection on a unix socket, then hangs up
+int metrics_serve(SimdMetrics* m, uv_loop_t* loop, const char* path);
+void metrics_unserve();
+
+#endif
@@ -30,6 +30,12 @@ ConfigError getParameters(int argc, char** argv, Parameters* p)
     p->udp                       = false;
     p->poke                      = false;
     p->targetval                 = false;
+    p->fixedrate                 = false;
+    p->udpstats                  = false;
+    p->rt                        = false;
+    p->recorddir                 = NULL;
+    p->capturedir                = NULL;
+    p->metricssocket             = NULL;
 
     // setup argument handling structures
     const char* progname = "simd";
@@ -44,10 +50,25 @@ ConfigError getParameters(int argc, char** argv, Parameters* p)
     struct arg_str* arg_target       = arg_str0("t", "target", "<string>", "target value ofpoke simdata");
 
     struct arg_lit* arg_udp          = arg_lit0("u", "udp", "force udp on all sims which support udp sufficiently");
+    struct arg_lit* arg_udpstats     = arg_lit0(NULL, "udp-stats", "log udp packet, burst and drop counters every 5 seconds");
+    struct arg_lit* arg_rt           = arg_lit0(NULL, "rt", "map and publish on a dedicated thread");
+    struct arg_int* arg_rtcpu        = arg_int0(NULL, "rt-cpu", "<cpu>", "pin the mapping thread to this cpu");
+    struct arg_int* arg_rtpriority   = arg_int0(NULL, "rt-priority", "<1-99>", "run the mapping thread with this SCHED_FIFO priority");
+    struct arg_lit* arg_fixedrate    = arg_lit0("f", "fixedrate", "map on a fixed 16ms timer instead of following the sim's frame counter");
+    struct arg_int* arg_pollrate     = arg_int0(NULL, "pollrate", "<hz>", "how often to check the sim's frame counter, default 1000");
+    struct arg_int* arg_maxrate      = arg_int0(NULL, "maxrate", "<hz>", "most frames per second to map, 0 for no limit, default 500");
+    struct arg_int* arg_coldrate     = arg_int0(NULL, "coldrate", "<hz>", "how often to publish SIMAPI.COLD, 0 for every frame, default 10");
+    struct arg_int* arg_history      = arg_int0(NULL, "history", "<frames>", "frames of physics to keep in SIMAPI.RING, 0 for none, default 512");
+    struct arg_int* arg_radarcars    = arg_int0(NULL, "radar-cars", "<cars>", "closest cars to keep in the proximity radar, at most 6, default 6");
+    struct arg_dbl* arg_radarradius  = arg_dbl0(NULL, "radar-radius", "<metres>", "how far out the proximity radar looks, default 10");
+    struct arg_dbl* arg_neighbours   = arg_dbl0(NULL, "neighbour-radius", "<metres>", "list the cars within this distance of each car in SIMAPI.CARS, 0 for none, default 50");
+    struct arg_str* arg_record       = arg_str0(NULL, "record", "<dir>", "record every published frame of each session to a file in this directory");
+    struct arg_str* arg_capture      = arg_str0(NULL, "capture", "<dir>", "capture the sim's raw shared memory or datagrams of each session to a file in this directory");
+    struct arg_str* arg_metrics      = arg_str0(NULL, "metrics-socket", "<path>", "serve simd's counters as Prometheus text on this unix socket");
     struct arg_lit* help             = arg_litn(NULL,"help", 0, 1, "print this help and exit");
     struct arg_lit* vers             = arg_litn(NULL,"version", 0, 1, "print version information and exit");
     struct arg_end* end              = arg_end(20);
-    void* argtable0[]                = {arg_nomemmap,arg_nodaemon,arg_nobridge,arg_nonotify,arg_poke,arg_target,arg_udp,arg_verbosity,help,vers,end};
+    void* argtable0[]                = {arg_nomemmap,arg_nodaemon,arg_nobridge,arg_nonotify,arg_poke,arg_target,arg_udp,arg_udpstats,arg_rt,arg_rtcpu,arg_rtpriority,arg_fixedrate,arg_pollrate,arg_maxrate,arg_coldrate,arg_history,arg_radarcars,arg_radarradius,arg_neighbours,arg_record,arg_capture,arg_metrics,arg_verbosity,help,vers,end};
     int nerrors0;
 
     if (arg_nullcheck(argtable0) != 0)
@@ -64,6 +85,15 @@ ConfigError getParameters(int argc, char** argv, Parameters* p)
         p->daemon_count = arg_nodaemon->count;
         p->notify_count = arg_nonotify->count;
         p->udp_count = arg_udp->count;
+        p->pollrate_count = arg_pollrate->count;
+        p->maxrate_count = arg_maxrate->count;
+        p->coldrate_count = arg_coldrate->count;
+        p->history_count = arg_history->count;
+        p->radarcars_count = arg_radarcars->count;
+        p->radarradius_count = arg_radarradius->count;
+        p->neighbourradius_count = arg_neighbours->count;
+        p->rtcpu_count = arg_rtcpu->count;
+        p->rtpriority_count = arg_rtpriority->count;
 
         if (arg_nodaemon->count > 0)
         {
@@ -85,6 +115,67 @@ ConfigError getParameters(int argc, char** argv, Parameters* p)
         {
             p->udp = true;
         }
+        if (arg_udpstats->count > 0)
+        {
+            p->udpstats = true;
+        }
+        if (arg_rt->count > 0)
+        {
+            p->rt = true;
+        }
+        if (arg_rtcpu->count > 0)
+        {
+            p->rtcpu = arg_rtcpu->ival[0];
+        }
+        if (arg_rtpriority->count > 0)
+        {
+            p->rtpriority = arg_rtpriority->ival[0];
+        }
+        if (arg_fixedrate->count > 0)
+        {
+            p->fixedrate = true;
+        }
+        if (arg_pollrate->count > 0)
+        {
+            p->pollrate = arg_pollrate->ival[0];
+        }
+        if (arg_maxrate->count > 0)
+        {
+            p->maxrate = arg_maxrate->ival[0];
+        }
+        if (arg_coldrate->count > 0)
+        {
+            p->coldrate = arg_coldrate->ival[0];
+        }
+        if (arg_history->count > 0)
+        {
+            p->history = arg_history->ival[0];
+        }
+        if (arg_radarcars->count > 0)
+        {
+            p->radarcars = arg_radarcars->ival[0];
+        }
+        if (arg_radarradius->count > 0)
+        {
+            p->radarradius = arg_radarradius->dval[0];
+        }
+        if (arg_neighbours->count > 0)
+        {
+            p->neighbourradius = arg_neighbours->dval[0];
+        }
+
+        if(arg_record->count > 0)
+        {
+            p->recorddir = strdup(arg_record->sval[0]);
+        }
+        if(arg_capture->count > 0)
+        {
+            p->capturedir = strdup(arg_capture->sval[0]);
+        }
+        if(arg_metrics->count > 0)
+        {
+            p->metricssocket = strdup(arg_metrics->sval[0]);
+        }
 
         if(arg_poke->count > 0)
         {
@@ -13,12 +13,33 @@ typedef struct
     bool udp;
     bool poke;
     bool targetval;
+    bool fixedrate;
+    bool udpstats;
+    bool rt;
+    int rtcpu;
+    int rtpriority;
+    int pollrate;
+    int maxrate;
+    int coldrate;
+    int history;
+    int radarcars;
+    double radarradius;
+    double neighbourradius;
 
     bool daemon_count;
     bool memmap_count;
     bool notify_count;
     bool bridge_count;
     bool udp_count;
+    bool pollrate_count;
+    bool maxrate_count;
+    bool coldrate_count;
+    bool history_count;
+    bool radarcars_count;
+    bool radarradius_count;
+    bool neighbourradius_count;
+    bool rtcpu_count;
+    bool rtpriority_count;
 
     bool user_specified_bridgepath;
     bool user_specified_compatpath;
@@ -27,6 +48,9 @@ typedef struct
     char* compatpath;
     char* pokesetting;
     char* targetvalue;
+    char* recorddir;
+    char* capturedir;
+    char* metricssocket;
 }
 Parameters;
 
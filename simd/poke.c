@@ -29,9 +29,8 @@
 int poke(SimdSettings simds)
 {
     int fd = shm_open(SIMAPI_MEM_FILE, O_RDWR, S_IRUSR | S_IWUSR);
-    int res = ftruncate(fd, sizeof(SimData));
-
-    SimData* s = mmap(NULL, sizeof(SimData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // simd sized the file to include the sync block, never shrink it
+    SimData* s = mmap(NULL, SIMAPI_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     struct Map* map = (struct Map*) malloc((1171 + 1) * sizeof(struct Map));
     int size = CreateSimDataMap(map, s, 1);
 
@@ -74,5 +73,12 @@ int poke(SimdSettings simds)
                 }
                 memcpy(addr, &val, sizeof(val));
         }
+
+        // tell the readers of changed regions, and have simd put the region back
+        // on its next frame rather than trust its copy of what the file holds
+        SimDataSync* sync = (SimDataSync*) ((char*) s + SIMAPI_SYNC_OFFSET);
+        size_t region = ((char*) addr - (char*) s) / SIMAPI_REGION_SIZE;
+        __atomic_add_fetch(&sync->regions[region], 1, __ATOMIC_RELAXED);
+        __atomic_or_fetch(&sync->poked, 1u << region, __ATOMIC_RELEASE);
     }
 }
@@ -0,0 +1,173 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <uv.h>
+
+#include "procwatch.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+static int procwatch_listen(int fd, enum proc_cn_mcast_op op)
+{
+    struct __attribute__((aligned(NLMSG_ALIGNTO)))
+    {
+        struct nlmsghdr hdr;
+        struct __attribute__((__packed__))
+        {
+            struct cn_msg msg;
+            enum proc_cn_mcast_op op;
+        } body;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.hdr.nlmsg_len = sizeof(req);
+    req.hdr.nlmsg_type = NLMSG_DONE;
+    req.hdr.nlmsg_pid = getpid();
+    req.body.msg.id.idx = CN_IDX_PROC;
+    req.body.msg.id.val = CN_VAL_PROC;
+    req.body.msg.len = sizeof(enum proc_cn_mcast_op);
+    req.body.op = op;
+
+    if (send(fd, &req, sizeof(req), 0) == -1)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int procwatch_open()
+{
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = getpid();
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1 || procwatch_listen(fd, PROC_CN_MCAST_LISTEN) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int procwatch_drain(int fd)
+{
+    char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int flags = 0;
+
+    for (;;)
+    {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return flags;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == ENOBUFS)
+            {
+                // the kernel dropped events, assume one of them mattered
+                flags |= PROCWATCH_EXEC;
+                continue;
+            }
+            return flags | PROCWATCH_LOST;
+        }
+        if (len == 0)
+        {
+            return flags | PROCWATCH_LOST;
+        }
+
+        for (struct nlmsghdr* hdr = (struct nlmsghdr*) buf; NLMSG_OK(hdr, len); hdr = NLMSG_NEXT(hdr, len))
+        {
+            if (hdr->nlmsg_type == NLMSG_NOOP || hdr->nlmsg_type == NLMSG_ERROR)
+            {
+                continue;
+            }
+            struct cn_msg* msg = NLMSG_DATA(hdr);
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC)
+            {
+                continue;
+            }
+            struct proc_event* ev = (struct proc_event*) msg->data;
+            // wine renames its preloader to the windows exe, so comm changes count too
+            if (ev->what == PROC_EVENT_EXEC || ev->what == PROC_EVENT_COMM)
+            {
+                flags |= PROCWATCH_EXEC;
+            }
+        }
+    }
+}
+
+void procwatch_close(int fd)
+{
+    if (fd == -1)
+    {
+        return;
+    }
+    procwatch_listen(fd, PROC_CN_MCAST_IGNORE);
+    close(fd);
+}
+
+static void pidwatch_free(uv_handle_t* handle)
+{
+    PidWatch* w = (PidWatch*) handle;
+    close(w->fd);
+    free(w);
+}
+
+PidWatch* pidwatch_start(pid_t pid, uv_poll_cb cb, void* data)
+{
+    if (pid <= 0)
+    {
+        return NULL;
+    }
+    int fd = syscall(SYS_pidfd_open, pid, 0);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    PidWatch* w = malloc(sizeof(PidWatch));
+    if (w == NULL || uv_poll_init(uv_default_loop(), &w->poll, fd) != 0)
+    {
+        free(w);
+        close(fd);
+        return NULL;
+    }
+    w->fd = fd;
+    w->pid = pid;
+    uv_handle_set_data((uv_handle_t*) &w->poll, data);
+    // a pidfd becomes readable when the process exits
+    uv_poll_start(&w->poll, UV_READABLE, cb);
+    return w;
+}
+
+void pidwatch_stop(PidWatch* w)
+{
+    if (w == NULL)
+    {
+        return;
+    }
+    uv_poll_stop(&w->poll);
+    uv_close((uv_handle_t*) &w->poll, pidwatch_free);
+}
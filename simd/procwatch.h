@@ -0,0 +1,39 @@
+#ifndef _PROCWATCH_H
+#define _PROCWATCH_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <uv.h>
+
+// exec and exit notifications from the kernel, so simd does not have to poll
+// /proc to find a game or kill(pid, 0) to notice it went away
+
+// wait this long after an exec before scanning, a burst of execs costs one scan
+#define PROCWATCH_SETTLE_MS 50
+// the connector drops events when its socket buffer fills, and a failed start
+// has no exec to wait for, so scan this often anyway
+#define PROCWATCH_FALLBACK_MS 10000
+
+#define PROCWATCH_EXEC 1 // something exec'd or renamed itself, worth a scan
+#define PROCWATCH_LOST 2 // the socket failed, go back to polling
+
+// subscribes to the proc connector, needs CAP_NET_ADMIN, returns -1 without it
+int procwatch_open();
+// reads every pending event, returns PROCWATCH_* flags
+int procwatch_drain(int fd);
+void procwatch_close(int fd);
+
+// one process watched through a pidfd, the callback runs once when it exits
+typedef struct
+{
+    uv_poll_t poll;
+    int fd;
+    pid_t pid;
+}
+PidWatch;
+
+// returns NULL when pidfd_open is not available or the pid is already gone
+PidWatch* pidwatch_start(pid_t pid, uv_poll_cb cb, void* data);
+void pidwatch_stop(PidWatch* w);
+
+#endif
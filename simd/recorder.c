@@ -0,0 +1,435 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <yder.h>
+
+#include <simapi.h>
+#include <simdata.h>
+#include "../simmap/basicmap.h"
+
+#include "recorder.h"
+
+// a field from CreateSimDataMap, or up to 8 bytes of SimData it does not describe
+typedef struct
+{
+    uint32_t offset;
+    uint8_t size;
+}
+RecorderSpan;
+
+typedef struct
+{
+    uint64_t time;
+    SimData simdata;
+}
+RecorderSlot;
+
+struct Recorder
+{
+    int fd;
+    char* map;
+    uint64_t mapoff;
+    uint64_t pos;
+    uint64_t started;
+
+    struct Map* fields;
+    RecorderSpan* spans;
+    int nspans;
+
+    RecorderSlot* ring;
+    uint32_t head; // written by the mapping path
+    uint32_t tail; // written by the flusher
+    uint64_t frames;
+    uint64_t dropped;
+    bool failed; // set by the flusher on its first failed write, nothing is written after
+
+    // flusher only
+    SimData prev;
+    uint8_t* encoded;
+    uint32_t sincekey;
+
+    bool running;
+    pthread_t thread;
+};
+
+static uint64_t recorder_clock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static uint8_t recorder_dtype_size(SimDataType dtype)
+{
+    switch (dtype)
+    {
+        case DOUBLE:
+        case UINT64:
+            return 8;
+        case INTEGER:
+        case FLOAT:
+        case UINT32:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+static int recorder_field_cmp(const void* a, const void* b)
+{
+    size_t x = (size_t) ((const struct Map*) a)->value;
+    size_t y = (size_t) ((const struct Map*) b)->value;
+    return (x > y) - (x < y);
+}
+
+// the same walk a reader does from the header: every described field in
+// offset order, anything between them cut into 8 byte pieces
+static int recorder_spans(Recorder* r)
+{
+    // a gap may end in a short piece, so up to one extra span per field
+    r->spans = malloc((2 * SIMDATAMAP_SIZE + sizeof(SimData) / 8 + 1) * sizeof(RecorderSpan));
+    if (r->spans == NULL)
+    {
+        return -1;
+    }
+
+    uint32_t cursor = 0;
+    int n = 0;
+    for (int k = 0; k <= SIMDATAMAP_SIZE; k++)
+    {
+        uint32_t end = sizeof(SimData);
+        uint8_t size = 0;
+        if (k < SIMDATAMAP_SIZE)
+        {
+            end = (uint32_t) (size_t) r->fields[k].value;
+            size = recorder_dtype_size(r->fields[k].dtype);
+            if (end < cursor)
+            {
+                continue;
+            }
+        }
+        while (cursor < end)
+        {
+            r->spans[n].offset = cursor;
+            r->spans[n].size = end - cursor < 8 ? end - cursor : 8;
+            cursor += r->spans[n].size;
+            n++;
+        }
+        if (size > 0)
+        {
+            r->spans[n].offset = cursor;
+            r->spans[n].size = size;
+            cursor += size;
+            n++;
+        }
+    }
+    r->nspans = n;
+    return 0;
+}
+
+static int recorder_map_chunk(Recorder* r)
+{
+    if (r->map != NULL)
+    {
+        munmap(r->map, RECORDER_CHUNK_SIZE);
+        r->map = NULL;
+    }
+
+    r->mapoff = r->pos - (r->pos % RECORDER_CHUNK_SIZE);
+    // allocate the blocks up front, a full disk is an error here and not a SIGBUS later
+    int err = posix_fallocate(r->fd, r->mapoff, RECORDER_CHUNK_SIZE);
+    if (err == EOPNOTSUPP || err == EINVAL)
+    {
+        err = ftruncate(r->fd, r->mapoff + RECORDER_CHUNK_SIZE) == 0 ? 0 : errno;
+    }
+    if (err != 0)
+    {
+        errno = err;
+        return -1;
+    }
+
+    void* map = mmap(NULL, RECORDER_CHUNK_SIZE, PROT_WRITE, MAP_SHARED, r->fd, r->mapoff);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+    r->map = map;
+    return 0;
+}
+
+static int recorder_write(Recorder* r, const void* buf, size_t len)
+{
+    const char* p = buf;
+    while (len > 0)
+    {
+        if (r->map == NULL || r->pos == r->mapoff + RECORDER_CHUNK_SIZE)
+        {
+            if (recorder_map_chunk(r) != 0)
+            {
+                return -1;
+            }
+        }
+        size_t room = r->mapoff + RECORDER_CHUNK_SIZE - r->pos;
+        size_t n = len < room ? len : room;
+        memcpy(r->map + (r->pos - r->mapoff), p, n);
+        r->pos += n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static size_t recorder_varint(uint8_t* out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+// for each changed span: varint(skipped spans << 4 | n) then the low n bytes
+// of the span xor its previous value, the high bytes of the xor being zero
+static size_t recorder_encode(Recorder* r, const uint8_t* cur, const uint8_t* prev)
+{
+    size_t len = 0;
+    int last = -1;
+    for (int i = 0; i < r->nspans; i++)
+    {
+        const RecorderSpan* sp = &r->spans[i];
+        uint64_t a = 0;
+        uint64_t b = 0;
+        memcpy(&a, cur + sp->offset, sp->size);
+        memcpy(&b, prev + sp->offset, sp->size);
+        uint64_t x = a ^ b;
+        if (x == 0)
+        {
+            continue;
+        }
+
+        int n = 8 - (__builtin_clzll(x) / 8);
+        len += recorder_varint(r->encoded + len, ((uint64_t) (i - last - 1) << 4) | n);
+        memcpy(r->encoded + len, &x, n);
+        len += n;
+        last = i;
+    }
+    return len;
+}
+
+// returns -1 when the file could not grow, the partly written record is cut off again
+static int recorder_flush_frame(Recorder* r, const RecorderSlot* slot)
+{
+    uint64_t start = r->pos;
+    int err = 0;
+    RecorderRecord rec;
+    rec.time = slot->time - r->started;
+
+    size_t len = 0;
+    if (r->sincekey != 0 && r->sincekey < RECORDER_KEYFRAME_INTERVAL)
+    {
+        len = recorder_encode(r, (const uint8_t*) &slot->simdata, (const uint8_t*) &r->prev);
+    }
+
+    if (r->sincekey == 0 || r->sincekey >= RECORDER_KEYFRAME_INTERVAL || len >= sizeof(SimData))
+    {
+        rec.type = RECORDER_RECORD_KEY;
+        rec.length = sizeof(SimData);
+        if (recorder_write(r, &rec, sizeof(rec)) != 0 || recorder_write(r, &slot->simdata, sizeof(SimData)) != 0)
+        {
+            err = -1;
+        }
+        r->sincekey = 1;
+    }
+    else
+    {
+        rec.type = RECORDER_RECORD_DELTA;
+        rec.length = len;
+        if (recorder_write(r, &rec, sizeof(rec)) != 0 || recorder_write(r, r->encoded, len) != 0)
+        {
+            err = -1;
+        }
+        r->sincekey++;
+    }
+    if (err != 0)
+    {
+        r->pos = start;
+        return -1;
+    }
+    memcpy(&r->prev, &slot->simdata, sizeof(SimData));
+    return 0;
+}
+
+static void* recorder_thread(void* arg)
+{
+    Recorder* r = arg;
+
+    for (;;)
+    {
+        bool running = __atomic_load_n(&r->running, __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        while (r->tail != head)
+        {
+            if (recorder_flush_frame(r, &r->ring[r->tail % RECORDER_RING_FRAMES]) != 0)
+            {
+                y_log_message(Y_LOG_LEVEL_ERROR, "Could not write the recording: %s, stopped recording", strerror(errno));
+                __atomic_store_n(&r->failed, true, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+        }
+        if (running == false)
+        {
+            break;
+        }
+        usleep(RECORDER_FLUSH_MS * 1000);
+    }
+    return NULL;
+}
+
+static int recorder_header(Recorder* r)
+{
+    RecorderHeader h;
+    memcpy(h.magic, RECORDER_MAGIC, sizeof(h.magic));
+    h.version = RECORDER_VERSION;
+    h.simdatasize = sizeof(SimData);
+    h.fields = SIMDATAMAP_SIZE;
+    h.keyframeinterval = RECORDER_KEYFRAME_INTERVAL;
+    h.started = recorder_clock(CLOCK_REALTIME);
+    if (recorder_write(r, &h, sizeof(h)) != 0)
+    {
+        return -1;
+    }
+
+    for (int k = 0; k < SIMDATAMAP_SIZE; k++)
+    {
+        RecorderField f;
+        size_t namelen = strlen(r->fields[k].name);
+        f.offset = (uint32_t) (size_t) r->fields[k].value;
+        f.dtype = r->fields[k].dtype;
+        f.namelen = namelen > 255 ? 255 : namelen;
+        if (recorder_write(r, &f, sizeof(f)) != 0 || recorder_write(r, r->fields[k].name, f.namelen) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void recorder_free(Recorder* r)
+{
+    if (r->map != NULL)
+    {
+        munmap(r->map, RECORDER_CHUNK_SIZE);
+    }
+    if (r->fd != -1)
+    {
+        // drop the unused tail of the last chunk
+        ftruncate(r->fd, r->pos);
+        close(r->fd);
+    }
+    free(r->fields);
+    free(r->spans);
+    free(r->ring);
+    free(r->encoded);
+    free(r);
+}
+
+Recorder* recorder_open(const char* dir)
+{
+    Recorder* r = calloc(1, sizeof(Recorder));
+    if (r == NULL)
+    {
+        return NULL;
+    }
+    r->fd = -1;
+
+    // mapdata 0 leaves every value as the field's offset into SimData
+    r->fields = malloc(SIMDATAMAP_SIZE * sizeof(struct Map));
+    r->ring = malloc(RECORDER_RING_FRAMES * sizeof(RecorderSlot));
+    r->encoded = malloc(sizeof(SimData) * 2);
+    if (r->fields == NULL || r->ring == NULL || r->encoded == NULL)
+    {
+        recorder_free(r);
+        return NULL;
+    }
+    CreateSimDataMap(r->fields, NULL, 0);
+    qsort(r->fields, SIMDATAMAP_SIZE, sizeof(struct Map), recorder_field_cmp);
+    if (recorder_spans(r) != 0)
+    {
+        recorder_free(r);
+        return NULL;
+    }
+
+    char path[4096];
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, sizeof(path), "%s/simd-%s.simrec", dir, stamp);
+
+    r->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (r->fd == -1 || recorder_header(r) != 0)
+    {
+        recorder_free(r);
+        return NULL;
+    }
+
+    r->started = recorder_clock(CLOCK_MONOTONIC);
+    r->running = true;
+    if (pthread_create(&r->thread, NULL, recorder_thread, r) != 0)
+    {
+        recorder_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+void recorder_frame(Recorder* r, const SimData* simdata)
+{
+    if (__atomic_load_n(&r->failed, __ATOMIC_ACQUIRE) == true)
+    {
+        return;
+    }
+    uint32_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RECORDER_RING_FRAMES)
+    {
+        r->dropped++;
+        return;
+    }
+
+    RecorderSlot* slot = &r->ring[head % RECORDER_RING_FRAMES];
+    slot->time = recorder_clock(CLOCK_MONOTONIC);
+    memcpy(&slot->simdata, simdata, sizeof(SimData));
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    r->frames++;
+}
+
+void recorder_stats(Recorder* r, uint64_t* frames, uint64_t* dropped, bool* failed)
+{
+    *frames = r->frames;
+    *dropped = r->dropped;
+    *failed = __atomic_load_n(&r->failed, __ATOMIC_ACQUIRE);
+}
+
+void recorder_close(Recorder* r)
+{
+    if (r == NULL)
+    {
+        return;
+    }
+    __atomic_store_n(&r->running, false, __ATOMIC_RELEASE);
+    pthread_join(r->thread, NULL);
+    recorder_free(r);
+}
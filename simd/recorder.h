@@ -0,0 +1,71 @@
+#ifndef _RECORDER_H
+#define _RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <simdata.h>
+
+// simd --record <dir>, every published SimData frame of a session appended to
+// <dir>/simd-<date>-<time>.simrec, see docs/simd_recording.md for the format
+
+#define RECORDER_MAGIC "SIMREC\0\1"
+#define RECORDER_VERSION 1
+
+#define RECORDER_RECORD_KEY   1 // the whole SimData
+#define RECORDER_RECORD_DELTA 2 // changed fields xor the previous frame
+
+// frames between keyframes, so a damaged file can be read from the next one
+#define RECORDER_KEYFRAME_INTERVAL 600
+// frames the mapping path can be ahead of the flusher before they are dropped
+#define RECORDER_RING_FRAMES 64
+#define RECORDER_FLUSH_MS 10
+// the file grows and is mapped this much at a time
+#define RECORDER_CHUNK_SIZE (8 * 1024 * 1024)
+
+#pragma pack(push)
+#pragma pack(1)
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t simdatasize;
+    uint32_t fields; // this many field descriptors follow, see RecorderField
+    uint32_t keyframeinterval;
+    uint64_t started; // unix time in ns
+}
+RecorderHeader;
+
+// followed by namelen bytes of name, no terminator
+typedef struct
+{
+    uint32_t offset;
+    uint8_t dtype; // SimDataType
+    uint8_t namelen;
+}
+RecorderField;
+
+typedef struct
+{
+    uint8_t type;
+    uint32_t length; // of the payload after this header
+    uint64_t time; // ns since started
+}
+RecorderRecord;
+
+#pragma pack(pop)
+
+typedef struct Recorder Recorder;
+
+// returns NULL if the file or the flusher thread could not be created
+Recorder* recorder_open(const char* dir);
+// copies the frame for the flusher, never blocks, drops the frame if the flusher is behind
+// does nothing once a write has failed, the flusher logs that and stops
+void recorder_frame(Recorder* r, const SimData* simdata);
+// frames queued and dropped by recorder_frame(), read it from the same thread
+// failed is set when the recording stopped early on a failed write
+void recorder_stats(Recorder* r, uint64_t* frames, uint64_t* dropped, bool* failed);
+// writes out what is queued, trims the file and frees r
+void recorder_close(Recorder* r);
+
+#endif
@@ -0,0 +1,374 @@
+// recvmmsg, struct mmsghdr and the cpu affinity calls
+#define _GNU_SOURCE
+
+#include "rtmap.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <yder.h>
+
+#include <simdata.h>
+#include <simmapper.h>
+
+#include "udphelper.h"
+#include "sourceclock.h"
+#include "metrics.h"
+
+#define RTMAP_FIXED_INTERVAL_MS 16
+// same two second settle time as the libuv timers
+#define RTMAP_START_DELAY_MS 2000
+#define RTMAP_COMMAND_RETRY_US 1000
+
+extern int appstate;
+extern SimdSettings simds;
+extern UdpStats udpstats;
+void publishsegments(SimData* simdata, SimMap* source, bool force);
+int capturesourceframe(SimMap* simmap, const char* base, size_t len);
+void metricsmapped(SimMap* simmap, SimulatorAPI sim, uint64_t start, bool udp);
+extern SimdMetrics* metrics;
+
+static SpscQueue commands;
+static SpscQueue events;
+static int cmdfd = -1;
+static int ackfd = -1;
+static int timerfd = -1;
+static pthread_t thread;
+static bool running = false;
+static bool active = false; // only touched by the control loop
+// bumped before every ack and read after it, so everything the thread wrote for
+// the session, the latency histograms, udpstats and the recorder, is the control
+// loop's to read and clear once rtmap_stop() returns
+static uint32_t acks = 0;
+static bool capturing = false; // only touched by the thread
+static uv_async_t* async;
+static LoopData* loop;
+
+static void arm_timer(long interval)
+{
+    struct itimerspec its;
+    its.it_value.tv_sec = RTMAP_START_DELAY_MS / 1000;
+    its.it_value.tv_nsec = (RTMAP_START_DELAY_MS % 1000) * 1000000;
+    its.it_interval.tv_sec = interval / 1000000000;
+    its.it_interval.tv_nsec = interval % 1000000000;
+    timerfd_settime(timerfd, 0, &its, NULL);
+}
+
+static void disarm_timer()
+{
+    struct itimerspec its = {0};
+    timerfd_settime(timerfd, 0, &its, NULL);
+}
+
+// false when the control loop has fallen so far behind that the queue is full
+static bool post_event(int type, int arg)
+{
+    bool posted = spsc_push(&events, (SpscMessage) { type, arg });
+    uv_async_send(async);
+    return posted;
+}
+
+static void ack()
+{
+    uint64_t one = 1;
+    __atomic_add_fetch(&acks, 1, __ATOMIC_RELEASE);
+    write(ackfd, &one, sizeof(one));
+}
+
+// a failed capture is left for the control loop to close, the thread just stops
+// feeding it, and tries to report it again next frame if the event did not fit
+static void capture(const char* base, size_t len)
+{
+    if (capturing == true && capturesourceframe(loop->simmap, base, len) != SIMAPI_ERROR_NONE)
+    {
+        capturing = post_event(RTMAP_EVENT_CAPTUREFAILED, 0) == false;
+    }
+}
+
+// returns true if the mapping should stop
+static bool map_shm(SourceClock* clock, bool counter)
+{
+    uint64_t expirations;
+    if (read(timerfd, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        return false;
+    }
+
+    SimData* simdata = loop->simdata;
+    if (counter == false || sourceclock_due(clock, loop->simmap, loop->sim, simds.maxrate, sourceclock_now()) == true)
+    {
+        uint64_t start = simapi_monotonic_ns();
+        simdatamap(simdata, loop->simmap, loop->simmap2, loop->sim, false, NULL);
+        metricsmapped(loop->simmap, loop->sim, start, false);
+        capture(NULL, 0);
+        publishsegments(simdata, loop->simmap, false);
+    }
+    return __atomic_load_n(&loop->simstate, __ATOMIC_RELAXED) == false || simdata->simstatus <= 1 || __atomic_load_n(&appstate, __ATOMIC_RELAXED) <= 1;
+}
+
+static bool map_udp(int udpfd, char* buffers, struct mmsghdr* msgs, struct iovec* iovs)
+{
+    char controls[UDP_RECVMMSG_DGRAMS][UDP_CONTROL_SIZE];
+    for (int i = 0; i < UDP_RECVMMSG_DGRAMS; i++)
+    {
+        iovs[i].iov_base = buffers + (i * UDP_DGRAM_SIZE);
+        iovs[i].iov_len = UDP_DGRAM_SIZE;
+        memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = controls[i];
+        msgs[i].msg_hdr.msg_controllen = UDP_CONTROL_SIZE;
+    }
+
+    int n = recvmmsg(udpfd, msgs, UDP_RECVMMSG_DGRAMS, MSG_DONTWAIT, NULL);
+    if (n <= 0)
+    {
+        if (n < 0 && errno != EAGAIN)
+        {
+            UDPSTATS_ADD(udpstats.errors, 1);
+        }
+        return false;
+    }
+
+    SimData* simdata = loop->simdata;
+    for (int i = 0; i < n; i++)
+    {
+        char* a = iovs[i].iov_base;
+        size_t nread = msgs[i].msg_len;
+        size_t tail = UDP_DGRAM_SIZE - nread < UDP_ZERO_TAIL ? UDP_DGRAM_SIZE - nread : UDP_ZERO_TAIL;
+        memset(a + nread, 0, tail);
+        udpstats_packet(&udpstats, nread, a, (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? UV_UDP_PARTIAL : 0);
+        simapi_source_time(loop->simmap, udp_receive_time(&msgs[i].msg_hdr));
+        uint64_t start = simapi_monotonic_ns();
+        simdatamap(simdata, loop->simmap, NULL, loop->sim, true, a);
+        metricsmapped(loop->simmap, loop->sim, start, true);
+        capture(a, nread);
+    }
+    udpstats_batch(&udpstats);
+    SimFrameTimes times;
+    simapi_frame_times(loop->simmap, &times);
+    simapi_set_frame_times(loop->simmap2, &times);
+    uint64_t start = simapi_monotonic_ns();
+    simdmap(loop->simmap2, simdata);
+    metrics_time(&metrics->write, simapi_monotonic_ns() - start);
+    publishsegments(simdata, loop->simmap, false);
+
+    return __atomic_load_n(&loop->simstate, __ATOMIC_RELAXED) == false || __atomic_load_n(&appstate, __ATOMIC_RELAXED) <= 1;
+}
+
+static void* rtmap_thread(void* arg)
+{
+    (void) arg;
+    bool mapping = false;
+    bool stopping = false;
+    bool counter = false;
+    int udpfd = -1;
+    SourceClock clock;
+
+    char* buffers = malloc(UDP_DGRAM_SIZE * UDP_RECVMMSG_DGRAMS);
+    struct mmsghdr msgs[UDP_RECVMMSG_DGRAMS];
+    struct iovec iovs[UDP_RECVMMSG_DGRAMS];
+
+    for (;;)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = cmdfd;
+        fds[0].events = POLLIN;
+        fds[1].fd = -1;
+        fds[1].events = POLLIN;
+        if (mapping == true && stopping == false)
+        {
+            fds[1].fd = udpfd >= 0 ? udpfd : timerfd;
+        }
+
+        if (poll(fds, 2, -1) == -1)
+        {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t n;
+            read(cmdfd, &n, sizeof(n));
+
+            SpscMessage m;
+            while (spsc_pop(&commands, &m) == true)
+            {
+                switch ( m.type )
+                {
+                    case RTMAP_CMD_START :
+                        mapping = true;
+                        stopping = false;
+                        capturing = true;
+                        udpfd = m.arg;
+                        if (udpfd >= 0)
+                        {
+                            udp_timestamps(udpfd);
+                        }
+                        else
+                        {
+                            uint64_t frame;
+                            counter = simds.source_driven == true && simapi_source_frame(loop->simmap, loop->sim, &frame) == true;
+                            if (counter == true)
+                            {
+                                sourceclock_reset(&clock, frame);
+                                arm_timer(1000000000 / simds.pollrate);
+                            }
+                            else
+                            {
+                                arm_timer((long) RTMAP_FIXED_INTERVAL_MS * 1000000);
+                            }
+                        }
+                        break;
+
+                    case RTMAP_CMD_STOP :
+                        mapping = false;
+                        disarm_timer();
+                        ack();
+                        break;
+
+                    case RTMAP_CMD_QUIT :
+                        disarm_timer();
+                        free(buffers);
+                        ack();
+                        return NULL;
+                }
+            }
+        }
+
+        if (fds[1].fd != -1 && (fds[1].revents & POLLIN))
+        {
+            bool stop;
+            if (udpfd >= 0)
+            {
+                stop = map_udp(udpfd, buffers, msgs, iovs);
+            }
+            else
+            {
+                stop = map_shm(&clock, counter);
+            }
+
+            // keep our hands off the sim until the control loop has released it,
+            // if the event did not fit the next frame asks again
+            if (stop == true && post_event(RTMAP_EVENT_WANTSTOP, 0) == true)
+            {
+                stopping = true;
+                disarm_timer();
+            }
+        }
+    }
+}
+
+int rtmap_init(LoopData* f, uv_async_t* wakeup)
+{
+    loop = f;
+    async = wakeup;
+
+    cmdfd = eventfd(0, EFD_CLOEXEC);
+    ackfd = eventfd(0, EFD_CLOEXEC);
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (cmdfd == -1 || ackfd == -1 || timerfd == -1)
+    {
+        return 1;
+    }
+
+    if (pthread_create(&thread, NULL, rtmap_thread, NULL) != 0)
+    {
+        return 2;
+    }
+    running = true;
+
+    if (simds.rtcpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(simds.rtcpu, &cpus);
+        if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0)
+        {
+            y_log_message(Y_LOG_LEVEL_WARNING, "could not pin the mapping thread to cpu %i", simds.rtcpu);
+        }
+    }
+    if (simds.rtpriority > 0)
+    {
+        struct sched_param param = { .sched_priority = simds.rtpriority };
+        int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+        if (err != 0)
+        {
+            y_log_message(Y_LOG_LEVEL_WARNING, "could not set SCHED_FIFO priority %i for the mapping thread: %s", simds.rtpriority, strerror(err));
+        }
+    }
+    return 0;
+}
+
+static void send_command(int type, int arg)
+{
+    uint64_t one = 1;
+    if (spsc_push(&commands, (SpscMessage) { type, arg }) == false)
+    {
+        // the thread is stuck in a frame, a lost stop would leave it mapping a freed sim
+        y_log_message(Y_LOG_LEVEL_WARNING, "the mapping thread is not taking commands, waiting for it");
+        write(cmdfd, &one, sizeof(one));
+        while (spsc_push(&commands, (SpscMessage) { type, arg }) == false)
+        {
+            usleep(RTMAP_COMMAND_RETRY_US);
+        }
+    }
+    write(cmdfd, &one, sizeof(one));
+}
+
+static void wait_ack()
+{
+    uint64_t n;
+    while (read(ackfd, &n, sizeof(n)) == -1 && errno == EINTR)
+    {
+    }
+    __atomic_load_n(&acks, __ATOMIC_ACQUIRE);
+}
+
+void rtmap_start(int udpfd)
+{
+    active = true;
+    send_command(RTMAP_CMD_START, udpfd);
+}
+
+// blocks until the thread has finished its current frame and let go of the sim
+void rtmap_stop()
+{
+    if (running == false || active == false)
+    {
+        return;
+    }
+    active = false;
+    send_command(RTMAP_CMD_STOP, 0);
+    wait_ack();
+}
+
+void rtmap_quit()
+{
+    if (running == false)
+    {
+        return;
+    }
+    send_command(RTMAP_CMD_QUIT, 0);
+    wait_ack();
+    pthread_join(thread, NULL);
+    running = false;
+    active = false;
+    close(cmdfd);
+    close(ackfd);
+    close(timerfd);
+}
+
+bool rtmap_pop_event(SpscMessage* m)
+{
+    return spsc_pop(&events, m);
+}
@@ -0,0 +1,32 @@
+#ifndef _RTMAP_H
+#define _RTMAP_H
+
+#include <uv.h>
+#include "loopdata.h"
+#include "spscqueue.h"
+
+// optional thread that does the mapping and publishing, so game detection,
+// bridge monitoring and /proc scans on the libuv loop never delay a frame
+
+typedef enum
+{
+    RTMAP_CMD_START = 0, // arg is the udp socket, or -1 for shared memory
+    RTMAP_CMD_STOP  = 1,
+    RTMAP_CMD_QUIT  = 2,
+}
+RtMapCommand;
+
+typedef enum
+{
+    RTMAP_EVENT_WANTSTOP = 0, // the sim stopped or the user asked to, call releaseloop()
+    RTMAP_EVENT_CAPTUREFAILED = 1, // the source capture could not be written, the thread no longer feeds it
+}
+RtMapEvent;
+
+int rtmap_init(LoopData* f, uv_async_t* wakeup);
+void rtmap_start(int udpfd);
+void rtmap_stop();
+void rtmap_quit();
+bool rtmap_pop_event(SpscMessage* m);
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "../simapi/ac.h"
+#include "../simapi/rf2.h"
+#include "../simapi/pcars2.h"
+
+#include "shmwatch.h"
+
+#define SHMWATCH_DIR "/dev/shm"
+#define SHMWATCH_SCS_DIR "/dev/shm/SCS"
+#define SHMWATCH_SCS_NAME "SCS"
+#define SHMWATCH_SCS_FILE "SCSTelemetry"
+
+#define SHMWATCH_EVENTS (IN_CREATE | IN_MOVED_TO | IN_MODIFY)
+
+static const char* simfiles[] =
+{
+    AC_PHYSICS_FILE,
+    AC_STATIC_FILE,
+    AC_GRAPHIC_FILE,
+    RF2_TELEMETRY_FILE,
+    RF2_SCORING_FILE,
+    PCARS2_FILE,
+};
+
+static int shmwd = -1;
+static int scswd = -1;
+
+static bool shmwatch_is_simfile(const char* name)
+{
+    for (size_t i = 0; i < sizeof(simfiles) / sizeof(simfiles[0]); i++)
+    {
+        if (strcmp(name, simfiles[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int shmwatch_open()
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    shmwd = inotify_add_watch(fd, SHMWATCH_DIR, SHMWATCH_EVENTS);
+    if (shmwd == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    // the truck sims' plugin makes this directory itself, it may not be there yet
+    scswd = inotify_add_watch(fd, SHMWATCH_SCS_DIR, SHMWATCH_EVENTS);
+    return fd;
+}
+
+bool shmwatch_drain(int fd)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool found = false;
+
+    for (;;)
+    {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len <= 0)
+        {
+            if (len == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            return found;
+        }
+
+        for (char* p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event*) p)->len)
+        {
+            struct inotify_event* ev = (struct inotify_event*) p;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                found = true;
+                continue;
+            }
+            if (ev->wd == scswd && (ev->mask & IN_IGNORED))
+            {
+                scswd = -1;
+                continue;
+            }
+            if (ev->len == 0)
+            {
+                continue;
+            }
+
+            if (ev->wd == shmwd)
+            {
+                if ((ev->mask & IN_ISDIR) && strcmp(ev->name, SHMWATCH_SCS_NAME) == 0)
+                {
+                    scswd = inotify_add_watch(fd, SHMWATCH_SCS_DIR, SHMWATCH_EVENTS);
+                }
+                else if (shmwatch_is_simfile(ev->name) == true)
+                {
+                    found = true;
+                }
+            }
+            else if (ev->wd == scswd && strcmp(ev->name, SHMWATCH_SCS_FILE) == 0)
+            {
+                found = true;
+            }
+        }
+    }
+}
+
+void shmwatch_close(int fd)
+{
+    if (fd == -1)
+    {
+        return;
+    }
+    close(fd);
+    shmwd = -1;
+    scswd = -1;
+}
@@ -0,0 +1,18 @@
+#ifndef _SHMWATCH_H
+#define _SHMWATCH_H
+
+#include <stdbool.h>
+
+// inotify on /dev/shm and /dev/shm/SCS, so simd attaches to a sim the moment
+// its bridge or plugin creates the shared memory instead of on the next check
+
+// a bridge creates the file then sizes it, give it that long before attaching
+#define SHMWATCH_SETTLE_MS 20
+
+// returns the inotify fd, or -1 if /dev/shm cannot be watched
+int shmwatch_open();
+// reads every pending event, true if a sim's shared memory file appeared or was resized
+bool shmwatch_drain(int fd);
+void shmwatch_close(int fd);
+
+#endif
@@ -16,7 +16,10 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include <simapi.h>
 #include <simdata.h>
@@ -31,9 +34,21 @@
 #include "dirhelper.h"
 #include "confighelper.h"
 #include "poke.h"
+#include "udphelper.h"
+#include "sourceclock.h"
+#include "rtmap.h"
+#include "procwatch.h"
+#include "shmwatch.h"
+#include "recorder.h"
+#include "metrics.h"
 
 #define PID_FILE "/tmp/simd.pid"
 
+#define SOURCE_POLL_RATE_DEFAULT 1000
+#define SOURCE_MAX_RATE_DEFAULT 500
+#define COLD_RATE_DEFAULT 10
+#define UDP_STATS_INTERVAL_MS 5000
+
 bool compatmemmap;
 
 Parameters* p;
@@ -41,6 +56,10 @@ LoopData* baton;
 SimData* simdata;
 SimMap* simmap;
 SimMap* simmap2;
+SimMap* hotmap;
+SimMap* coldmap;
+SimMap* ringmap;
+SimMap* carsmap;
 SimCompatMap* compatmap;
 GameCompatInfo* game_compat_info;
 SimdSettings simds;
@@ -53,18 +72,59 @@ uv_timer_t gamefindtimer;
 uv_timer_t datachecktimer;
 uv_timer_t datamaptimer;
 uv_timer_t bridgeclosetimer;
+uv_timer_t udpstatstimer;
+uv_timer_t metricstimer;
+uv_async_t rtasync;
+uv_poll_t sourcepoll;
 uv_udp_t recv_socket;
 bool recv_socket_initialized = false;
 bool recv_socket_bound = false;
+bool sourcepoll_initialized = false;
+int sourcetimerfd = -1;
+SourceClock sourceclock;
+uint64_t coldlastmap = 0;
+UdpStats udpstats;
 
 int appstate = 0;
 int compat_info_size = 0;
+ProcScan* procscan = NULL;
+int procscan_sims = -1;
+int procfd = -1;
+uv_poll_t procpoll;
+bool gamefinding = false;
+// an exec started the settle time before the next scan, see procpollcallback
+bool gamefindsettling = false;
+PidWatch* gamewatch = NULL;
+PidWatch* bridgewatch = NULL;
+int shmfd = -1;
+Recorder* recorder = NULL;
+SimSourceFile* capture = NULL;
+// this session's source to mapped, mapped to published and source to published times
+SimLatencyHistogram latencymap;
+SimLatencyHistogram latencypublish;
+SimLatencyHistogram latencytotal;
+SimdMetrics* metrics = NULL;
+uint64_t datamaplast = 0;
+uv_poll_t shmpoll;
 int gamepid = 0;
 
 void shmdatamapcallback(uv_timer_t* handle);
 void datacheckcallback(uv_timer_t* handle);
 void gamefindcallback(uv_timer_t* handle);
+void startgamefind();
+void stopexitwatch();
 void bridgeclosecallback(uv_timer_t* handle);
+void stopsourcepoll();
+void publishsegments(SimData* simdata, SimMap* source, bool force);
+void startrecording();
+void stoprecording();
+void startcapture(LoopData* f);
+void loglatency(SimulatorEXE simexe);
+void stopcapture();
+void capturesource(SimMap* simmap, const char* base, size_t len);
+int capturesourceframe(SimMap* simmap, const char* base, size_t len);
+void releaseloop(LoopData* f, SimData* simdata, SimMap* simmap);
+void metricsmapped(SimMap* simmap, SimulatorAPI sim, uint64_t start, bool udp);
 
 void simapilib_loginfo(char* message)
 {
@@ -109,6 +169,58 @@ int set_settings(Parameters* p, SimdSettings* simds)
 
     simds->auto_bridge = p->bridge;
 
+    simds->source_driven = !p->fixedrate;
+    simds->pollrate = SOURCE_POLL_RATE_DEFAULT;
+    if(p->pollrate_count > 0 && p->pollrate > 0)
+    {
+        simds->pollrate = p->pollrate;
+    }
+    simds->udp_stats = p->udpstats;
+
+    simds->rt = p->rt;
+    simds->rtcpu = -1;
+    if(p->rtcpu_count > 0)
+    {
+        simds->rtcpu = p->rtcpu;
+    }
+    simds->rtpriority = 0;
+    if(p->rtpriority_count > 0)
+    {
+        simds->rtpriority = p->rtpriority;
+    }
+
+    simds->coldrate = COLD_RATE_DEFAULT;
+    if(p->coldrate_count > 0 && p->coldrate >= 0)
+    {
+        simds->coldrate = p->coldrate;
+    }
+    simds->history = SIMAPI_RING_DEFAULT_SLOTS;
+    if(p->history_count > 0 && p->history >= 0)
+    {
+        simds->history = p->history;
+    }
+    simds->maxrate = SOURCE_MAX_RATE_DEFAULT;
+    if(p->maxrate_count > 0 && p->maxrate >= 0)
+    {
+        simds->maxrate = p->maxrate;
+    }
+
+    simds->recorddir = NULL;
+    if(p->recorddir != NULL)
+    {
+        simds->recorddir = strdup(p->recorddir);
+    }
+    simds->capturedir = NULL;
+    if(p->capturedir != NULL)
+    {
+        simds->capturedir = strdup(p->capturedir);
+    }
+    simds->metricssocket = NULL;
+    if(p->metricssocket != NULL)
+    {
+        simds->metricssocket = strdup(p->metricssocket);
+    }
+
     simds->poke = false;
     if(p->poke == true)
     {
@@ -142,15 +254,34 @@ void release()
     uv_timer_stop(&gamefindtimer);
     uv_timer_stop(&datamaptimer);
     uv_timer_stop(&datachecktimer);
+    stopsourcepoll();
+    uv_timer_stop(&udpstatstimer);
+    uv_timer_stop(&metricstimer);
+    metrics_unserve();
     if (recv_socket_initialized)
     {
         uv_udp_recv_stop(&recv_socket);
     }
     uv_timer_stop(&bridgeclosetimer);
+    stopexitwatch();
+    if (procfd != -1)
+    {
+        uv_poll_stop(&procpoll);
+    }
+    if (shmfd != -1)
+    {
+        uv_poll_stop(&shmpoll);
+    }
+    rtmap_quit();
     uv_walk(uv_default_loop(), close_walk_cb, NULL);
     uv_run(uv_default_loop(), UV_RUN_DEFAULT);
     ASSERT(0 == uv_loop_close(uv_default_loop()));
     uv_library_shutdown();
+    if (sourcetimerfd != -1)
+    {
+        close(sourcetimerfd);
+    }
+    udppool_free();
 
     if(compatmemmap == true)
     {
@@ -160,6 +291,11 @@ void release()
 
     freesimmap(simmap, true);
     freesimmap(simmap2, true);
+    freesimmap(hotmap, true);
+    freesimmap(coldmap, true);
+    freesimmap(ringmap, true);
+    freesimmap(carsmap, true);
+    metrics_close(metrics);
 
     free(baton);
     free(simdata);
@@ -173,10 +309,16 @@ void release()
         }
         free(game_compat_info);
     }
+    procscan_free(procscan);
+    procwatch_close(procfd);
+    shmwatch_close(shmfd);
     free(p);
 
     free(simds.home_dir);
     free(simds.configfile);
+    free(simds.recorddir);
+    free(simds.capturedir);
+    free(simds.metricssocket);
 
     unlink(PID_FILE);
 
@@ -205,10 +347,14 @@ void releaseloop(LoopData* f, SimData* simdata, SimMap* simmap)
 
     if(f->releasing == false)
     {
+        // the mapping thread has to let go of the sim before we free it
+        rtmap_stop();
 
         f->releasing = true;
         appstate = 1;
         uv_timer_stop(&datamaptimer);
+        datamaplast = 0;
+        stopsourcepoll();
         y_log_message(Y_LOG_LEVEL_INFO, "stopping data mapping, please wait");
         f->uion = false;
 
@@ -219,10 +365,17 @@ void releaseloop(LoopData* f, SimData* simdata, SimMap* simmap)
         if (simmap2 != NULL)
         {
             simdmap(simmap2, simdata);
+            publishsegments(simdata, NULL, true);
         }
         // Properly close the UDP socket if it's open
         if (recv_socket_initialized)
         {
+            if (simds.udp_stats == true)
+            {
+                uv_timer_stop(&udpstatstimer);
+                udpstats_log(&udpstats, &recv_socket);
+            }
+            udpstats_drops(&udpstats, &recv_socket);
             if (uv_is_active((uv_handle_t*)&recv_socket))
             {
                 uv_udp_recv_stop(&recv_socket);
@@ -236,6 +389,16 @@ void releaseloop(LoopData* f, SimData* simdata, SimMap* simmap)
             recv_socket_bound = false;
         }
 
+        SimSnapshotStats snapshotstats;
+        simapi_snapshot_stats(simmap, &snapshotstats);
+        y_log_message(Y_LOG_LEVEL_INFO, "source reads: %lu, torn and retried: %lu, gave up: %lu", (unsigned long) snapshotstats.reads, (unsigned long) snapshotstats.torn, (unsigned long) snapshotstats.failed);
+        metrics_stop(metrics, &udpstats, &snapshotstats);
+        memset(&udpstats, 0, sizeof(udpstats));
+
+        stoprecording();
+        stopcapture();
+        loglatency(simdata->simexe);
+
         int r = simfree(simdata, simmap, f->sim);
         y_log_message(Y_LOG_LEVEL_DEBUG, "simfree returned %i", r);
 
@@ -256,10 +419,8 @@ void releaseloop(LoopData* f, SimData* simdata, SimMap* simmap)
 
 }
 
-void shmdatamapcallback(uv_timer_t* handle)
+void shmdatamap(LoopData* f)
 {
-    void* b = uv_handle_get_data((uv_handle_t*) handle);
-    LoopData* f = (LoopData*) b;
     SimData* simdata = f->simdata;
     SimMap* simmap = f->simmap;
     SimMap* simmap2 = f->simmap2;
@@ -267,7 +428,11 @@ void shmdatamapcallback(uv_timer_t* handle)
     //appstate = 2;
     if (appstate == 2)
     {
+        uint64_t start = simapi_monotonic_ns();
         simdatamap(simdata, simmap, simmap2, f->sim, false, NULL);
+        metricsmapped(simmap, f->sim, start, false);
+        capturesource(simmap, NULL, 0);
+        publishsegments(simdata, simmap, false);
     }
 
     if (f->simstate == false || simdata->simstatus <= 1 || appstate <= 1)
@@ -276,42 +441,348 @@ void shmdatamapcallback(uv_timer_t* handle)
     }
 }
 
-void on_alloc(uv_handle_t* client, size_t suggested_size, uv_buf_t* buf)
+void shmdatamapcallback(uv_timer_t* handle)
 {
-    buf->base = malloc(suggested_size);
-    buf->len = suggested_size;
-    bzero(buf->base, suggested_size);
+    void* b = uv_handle_get_data((uv_handle_t*) handle);
+    LoopData* f = (LoopData*) b;
+
+    uint64_t now = simapi_monotonic_ns();
+    if (datamaplast != 0)
+    {
+        int64_t off = (int64_t) (now - datamaplast) - (int64_t) uv_timer_get_repeat(handle) * 1000000;
+        metrics_time(&metrics->jitter, off < 0 ? -off : off);
+    }
+    datamaplast = now;
+
+    shmdatamap(f);
 }
 
-static void on_udp_recv(uv_udp_t* handle, ssize_t nread, const uv_buf_t* rcvbuf, const struct sockaddr* addr, unsigned flags)
+// simdatamap() stamps the frame as mapped before it writes SIMAPI.DAT, which splits its time in two
+// udp datagrams are mapped one at a time and written once per batch, see on_udp_batch()
+void metricsmapped(SimMap* simmap, SimulatorAPI sim, uint64_t start, bool udp)
 {
-    if (nread <= 0)
+    uint64_t end = simapi_monotonic_ns();
+    SimFrameTimes times;
+    simapi_frame_times(simmap, &times);
+    metrics_frame(metrics, sim);
+
+    if (times.mapped < start || times.mapped > end)
+    {
+        metrics_time(&metrics->map, end - start);
+        return;
+    }
+    metrics_time(&metrics->map, times.mapped - start);
+    if (udp == false)
+    {
+        metrics_time(&metrics->write, end - times.mapped);
+    }
+    else if (times.source != 0 && times.mapped - times.source > SIMD_METRICS_LATE_NS)
+    {
+        METRICS_SET(metrics->udplate, metrics->udplate + 1);
+    }
+}
+
+void sourcepollcallback(uv_poll_t* handle, int status, int events)
+{
+    (void) status;
+    (void) events;
+    void* b = uv_handle_get_data((uv_handle_t*) handle);
+    LoopData* f = (LoopData*) b;
+
+    uint64_t expirations;
+    if (read(sourcetimerfd, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        return;
+    }
+
+    if (sourceclock_due(&sourceclock, f->simmap, f->sim, simds.maxrate, sourceclock_now()) == true)
+    {
+        shmdatamap(f);
+    }
+}
+
+// SIMAPI.HOT goes out with every frame, SIMAPI.COLD at most coldrate times a second
+// source is the SimMap the frame was mapped with, for its timestamps, NULL when simd made the frame up
+void publishsegments(SimData* simdata, SimMap* source, bool force)
+{
+    uint64_t start = simapi_monotonic_ns();
+    SimFrameTimes times = {0};
+    if (source != NULL)
+    {
+        simapi_frame_times(source, &times);
+    }
+    simapi_set_frame_times(hotmap, &times);
+    simapi_set_frame_times(coldmap, &times);
+    simapi_set_frame_times(ringmap, &times);
+    simapi_set_frame_times(carsmap, &times);
+
+    if (recorder != NULL)
+    {
+        recorder_frame(recorder, simdata);
+    }
+    if (hotmap->sync != NULL)
+    {
+        simsegmentmap(hotmap, simdata);
+    }
+    if (ringmap->sync != NULL)
+    {
+        simringmap(ringmap, simdata);
+    }
+    if (carsmap->sync != NULL)
+    {
+        simsegmentmap(carsmap, simdata);
+    }
+
+    if (times.source != 0 && times.mapped >= times.source)
+    {
+        uint64_t published = simapi_monotonic_ns();
+        simapi_latency_add(&latencymap, times.mapped - times.source);
+        simapi_latency_add(&latencypublish, published - times.mapped);
+        simapi_latency_add(&latencytotal, published - times.source);
+    }
+
+    uint64_t now = sourceclock_now();
+    if (force == true || simds.coldrate <= 0 || now - __atomic_load_n(&coldlastmap, __ATOMIC_RELAXED) >= 1000000000 / (uint64_t) simds.coldrate)
+    {
+        if (coldmap->sync != NULL)
+        {
+            simsegmentmap(coldmap, simdata);
+        }
+        if (carsmap->sync != NULL)
+        {
+            simcarnamesmap(carsmap, simdata);
+        }
+        __atomic_store_n(&coldlastmap, now, __ATOMIC_RELAXED);
+    }
+
+    if (source != NULL)
+    {
+        metrics_time(&metrics->publish, simapi_monotonic_ns() - start);
+    }
+}
+
+static void loglatencystage(const char* stage, SimLatencyHistogram* h)
+{
+    y_log_message(Y_LOG_LEVEL_INFO, "latency %s: p50 %lu us, p99 %lu us, max %lu us", stage,
+                  (unsigned long) simapi_latency_percentile(h, 50) / 1000, (unsigned long) simapi_latency_percentile(h, 99) / 1000, (unsigned long) h->max / 1000);
+}
+
+// logged and cleared at the end of each session, so every line is for one sim
+void loglatency(SimulatorEXE simexe)
+{
+    if (latencytotal.count > 0)
+    {
+        y_log_message(Y_LOG_LEVEL_INFO, "latency over %lu frames of %s", (unsigned long) latencytotal.count, simapi_gametofullstr(simexe));
+        loglatencystage("source to mapped", &latencymap);
+        loglatencystage("mapped to published", &latencypublish);
+        loglatencystage("source to published", &latencytotal);
+    }
+    memset(&latencymap, 0, sizeof(latencymap));
+    memset(&latencypublish, 0, sizeof(latencypublish));
+    memset(&latencytotal, 0, sizeof(latencytotal));
+}
+
+void startrecording()
+{
+    if (simds.recorddir == NULL || recorder != NULL)
+    {
+        return;
+    }
+    recorder = recorder_open(simds.recorddir);
+    if (recorder == NULL)
+    {
+        y_log_message(Y_LOG_LEVEL_WARNING, "Could not start recording to %s", simds.recorddir);
+        return;
+    }
+    y_log_message(Y_LOG_LEVEL_INFO, "recording session to %s", simds.recorddir);
+}
+
+void stoprecording()
+{
+    if (recorder == NULL)
+    {
+        return;
+    }
+    uint64_t frames;
+    uint64_t dropped;
+    bool failed;
+    recorder_stats(recorder, &frames, &dropped, &failed);
+    recorder_close(recorder);
+    recorder = NULL;
+    y_log_message(failed == true ? Y_LOG_LEVEL_WARNING : Y_LOG_LEVEL_INFO, "recorded %lu frames, dropped %lu%s", (unsigned long) frames, (unsigned long) dropped, failed == true ? ", stopped early on a failed write" : "");
+}
+
+// the sim's own pages or datagrams, for replaying through the mappers later
+void startcapture(LoopData* f)
+{
+    if (simds.capturedir == NULL || capture != NULL)
     {
-        free(rcvbuf->base);
         return;
     }
 
-    if (nread > 0)
+    char path[4096];
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, sizeof(path), "%s/simd-%s.simsrc", simds.capturedir, stamp);
+
+    capture = simapi_capture_open(path, f->sim, f->simdata->simexe);
+    if (capture == NULL)
     {
-        y_log_message(Y_LOG_LEVEL_DEBUG, "UDP packet received: %zd bytes", nread);
+        y_log_message(Y_LOG_LEVEL_WARNING, "Could not start capturing to %s", path);
+        return;
     }
+    y_log_message(Y_LOG_LEVEL_INFO, "capturing sim source to %s", path);
+}
 
-    char* a;
-    a = rcvbuf->base;
+void stopcapture()
+{
+    if (capture == NULL)
+    {
+        return;
+    }
+    uint64_t frames;
+    uint64_t dropped;
+    simapi_capture_stats(capture, &frames, &dropped);
+    simapi_capture_close(capture);
+    capture = NULL;
+    y_log_message(Y_LOG_LEVEL_INFO, "stopped capturing sim source, captured %lu frames, dropped %lu", (unsigned long) frames, (unsigned long) dropped);
+}
+
+// safe on the mapping thread, it only ever reads capture, which the control loop
+// sets before the thread starts and clears after it stopped
+int capturesourceframe(SimMap* simmap, const char* base, size_t len)
+{
+    if (capture == NULL)
+    {
+        return SIMAPI_ERROR_NONE;
+    }
+    return simapi_capture_frame(capture, simmap, base, len);
+}
+
+void capturesource(SimMap* simmap, const char* base, size_t len)
+{
+    if (capturesourceframe(simmap, base, len) != SIMAPI_ERROR_NONE)
+    {
+        y_log_message(Y_LOG_LEVEL_WARNING, "Could not write sim source capture, stopping");
+        stopcapture();
+    }
+}
 
+int startsourcepoll(LoopData* f)
+{
+    uint64_t frame;
+    if (simapi_source_frame(f->simmap, f->sim, &frame) == false)
+    {
+        return 1;
+    }
+
+    if (sourcetimerfd == -1)
+    {
+        sourcetimerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (sourcetimerfd == -1)
+        {
+            return 2;
+        }
+    }
+    if (sourcepoll_initialized == false)
+    {
+        uv_poll_init(uv_default_loop(), &sourcepoll, sourcetimerfd);
+        uv_handle_set_data((uv_handle_t*) &sourcepoll, (void*) f);
+        sourcepoll_initialized = true;
+    }
+
+    // same two second settle time as the fixed timer
+    long interval = 1000000000 / simds.pollrate;
+    struct itimerspec its;
+    its.it_value.tv_sec = 2;
+    its.it_value.tv_nsec = 0;
+    its.it_interval.tv_sec = interval / 1000000000;
+    its.it_interval.tv_nsec = interval % 1000000000;
+    if (timerfd_settime(sourcetimerfd, 0, &its, NULL) == -1)
+    {
+        return 3;
+    }
+
+    sourceclock_reset(&sourceclock, frame);
+    uv_poll_start(&sourcepoll, UV_READABLE, sourcepollcallback);
+    return 0;
+}
+
+void udpstatscallback(uv_timer_t* handle)
+{
+    (void) handle;
+    udpstats_log(&udpstats, &recv_socket);
+}
+
+void metricscallback(uv_timer_t* handle)
+{
+    (void) handle;
+    if (recv_socket_initialized)
+    {
+        udpstats_drops(&udpstats, &recv_socket);
+    }
+    SimSnapshotStats snapshotstats;
+    simapi_snapshot_stats(simmap, &snapshotstats);
+    metrics_refresh(metrics, &udpstats, &snapshotstats);
+}
+
+void rtmapcallback(uv_async_t* handle)
+{
     void* b = uv_handle_get_data((uv_handle_t*) handle);
     LoopData* f = (LoopData*) b;
+
+    SpscMessage m;
+    while (rtmap_pop_event(&m) == true)
+    {
+        if (m.type == RTMAP_EVENT_WANTSTOP)
+        {
+            releaseloop(f, f->simdata, f->simmap);
+        }
+        else if (m.type == RTMAP_EVENT_CAPTUREFAILED)
+        {
+            // the thread has stopped capturing, releaseloop() closes the file once it let go
+            y_log_message(Y_LOG_LEVEL_WARNING, "Could not write sim source capture, stopping");
+        }
+    }
+}
+
+void stopsourcepoll()
+{
+    if (sourcepoll_initialized == false)
+    {
+        return;
+    }
+    uv_poll_stop(&sourcepoll);
+    struct itimerspec its = {0};
+    timerfd_settime(sourcetimerfd, 0, &its, NULL);
+}
+
+void on_alloc(uv_handle_t* client, size_t suggested_size, uv_buf_t* buf)
+{
+    // every buffer in the pool is the same size
+    (void) suggested_size;
+    udppool_alloc(buf);
+}
+
+// the end of a receive, either a single datagram or the last of a recvmmsg batch
+static void on_udp_batch(LoopData* f)
+{
     SimData* simdata = f->simdata;
     SimMap* simmap = f->simmap;
-    SimMap* simmap2 = f->simmap2;
 
+    udpstats_batch(&udpstats);
     if (appstate == 2)
     {
-        simdatamap(simdata, simmap, simmap2, f->sim, true, a);
-    }
-    else
-    {
-        y_log_message(Y_LOG_LEVEL_DEBUG, "UDP packet received but appstate is %d (expected 2)", appstate);
+        SimFrameTimes times;
+        simapi_frame_times(simmap, &times);
+        simapi_set_frame_times(f->simmap2, &times);
+        uint64_t start = simapi_monotonic_ns();
+        simdmap(f->simmap2, simdata);
+        metrics_time(&metrics->write, simapi_monotonic_ns() - start);
+        publishsegments(simdata, simmap, false);
     }
 
     /*
@@ -324,8 +795,62 @@ static void on_udp_recv(uv_udp_t* handle, ssize_t nread, const uv_buf_t* rcvbuf,
     {
         releaseloop(f, simdata, simmap);
     }
+}
+
+static void on_udp_recv(uv_udp_t* handle, ssize_t nread, const uv_buf_t* rcvbuf, const struct sockaddr* addr, unsigned flags)
+{
+    void* b = uv_handle_get_data((uv_handle_t*) handle);
+    LoopData* f = (LoopData*) b;
+
+    // with recvmmsg every datagram of a batch shares one pool slot, flagged
+    // UV_UDP_MMSG_CHUNK, and libuv hands the slot back with UV_UDP_MMSG_FREE
+    bool chunk = (flags & UV_UDP_MMSG_CHUNK) != 0;
+    if (flags & UV_UDP_MMSG_FREE)
+    {
+        udppool_release(rcvbuf->base);
+        on_udp_batch(f);
+        return;
+    }
+
+    if (nread <= 0)
+    {
+        if (nread < 0)
+        {
+            udpstats_packet(&udpstats, nread, rcvbuf->base, flags);
+        }
+        if (chunk == false)
+        {
+            udppool_release(rcvbuf->base);
+        }
+        return;
+    }
+
+    y_log_message(Y_LOG_LEVEL_DEBUG, "UDP packet received: %zd bytes", nread);
+    udpstats_packet(&udpstats, nread, rcvbuf->base, flags);
+
+    // the mappers get a view straight into the pool slot
+    char* a = rcvbuf->base;
+    size_t tail = rcvbuf->len - nread < UDP_ZERO_TAIL ? rcvbuf->len - nread : UDP_ZERO_TAIL;
+    memset(a + nread, 0, tail);
 
-    free(rcvbuf->base);
+    if (appstate == 2)
+    {
+        // publish once per batch rather than once per datagram
+        uint64_t start = simapi_monotonic_ns();
+        simdatamap(f->simdata, f->simmap, NULL, f->sim, true, a);
+        metricsmapped(f->simmap, f->sim, start, true);
+        capturesource(f->simmap, a, nread);
+    }
+    else
+    {
+        y_log_message(Y_LOG_LEVEL_DEBUG, "UDP packet received but appstate is %d (expected 2)", appstate);
+    }
+
+    if (chunk == false)
+    {
+        udppool_release(rcvbuf->base);
+        on_udp_batch(f);
+    }
 }
 
 int startudp(int port)
@@ -342,7 +867,13 @@ int startudp(int port)
     }
     if (!recv_socket_initialized)
     {
+#if UV_VERSION_HEX >= 0x012800
+        uv_udp_init_ex(uv_default_loop(), &recv_socket, AF_INET | UV_UDP_RECVMMSG);
+        udppool_init(uv_udp_using_recvmmsg(&recv_socket) == 1);
+#else
         uv_udp_init(uv_default_loop(), &recv_socket);
+        udppool_init(false);
+#endif
         uv_handle_set_data((uv_handle_t*) &recv_socket, (void*) baton);
         recv_socket_initialized = true;
     }
@@ -390,84 +921,229 @@ int is_pid_running(pid_t pid)
     }
 }
 
+void stopexitwatch()
+{
+    pidwatch_stop(gamewatch);
+    gamewatch = NULL;
+    pidwatch_stop(bridgewatch);
+    bridgewatch = NULL;
+}
+
+void gameclosed(LoopData* f)
+{
+    SimData* simdata = f->simdata;
+    SimMap* simmap = f->simmap;
+
+    stopexitwatch();
+    uv_timer_stop(&bridgeclosetimer);
+
+    if(simds.notify == true)
+    {
+        char cmd[512];
+        snprintf(cmd, sizeof(cmd), "notify-send -t 3000 \"%s\" \"game stopped\"", "simd");
+        system(cmd);
+    }
+
+    if(f->bridge_pid > 0)
+    {
+        kill(f->bridge_pid, SIGTERM);
+        y_log_message(Y_LOG_LEVEL_INFO, "Sent SIGTERM to bridge pid");
+    }
+    f->bridge_pid = 0;
+    f->game_pid = 0;
+    __atomic_store_n(&appstate, 1, __ATOMIC_RELAXED);
+    releaseloop(f, simdata, simmap);
+    //int r = simfree(simdata, simmap, f->sim);
+    //y_log_message(Y_LOG_LEVEL_DEBUG, "simfree returned %i.", r);
+
+    if(simds.auto_bridge == true)
+    {
+        y_log_message(Y_LOG_LEVEL_INFO, "Starting Bridge Polling Thread.");
+        startgamefind();
+    }
+    else
+    {
+        y_log_message(Y_LOG_LEVEL_INFO, "Starting Data Mapping Thread.");
+        uv_timer_start(&datachecktimer, datacheckcallback, 1000, 1000);
+    }
+}
+
 void bridgeclosecallback(uv_timer_t* handle)
 {
     void* b = uv_handle_get_data((uv_handle_t*) handle);
     LoopData* f = (LoopData*) b;
-    SimData* simdata = f->simdata;
-    SimMap* simmap = f->simmap;
 
     if(is_pid_running(f->game_pid) == 0)
     {
         y_log_message(Y_LOG_LEVEL_INFO, "No longer detected game pid %i, so closing bridge pid %i", f->game_pid, f->bridge_pid);;
+        gameclosed(f);
+    }
+}
 
-        if(simds.notify == true)
-        {
-            char cmd[512];
-            snprintf(cmd, sizeof(cmd), "notify-send -t 3000 \"%s\" \"game stopped\"", "simd");
-            system(cmd);
-        }
+void gameexitcallback(uv_poll_t* handle, int status, int events)
+{
+    (void) status;
+    (void) events;
+    void* b = uv_handle_get_data((uv_handle_t*) handle);
+    LoopData* f = (LoopData*) b;
 
-        if(f->bridge_pid > 0)
-        {
-            kill(f->bridge_pid, SIGTERM);
-            y_log_message(Y_LOG_LEVEL_INFO, "Sent SIGTERM to bridge pid");
-        }
-        f->bridge_pid = 0;
-        f->game_pid = 0;
-        uv_timer_stop(handle);
-        appstate = 1;
-        releaseloop(f, simdata, simmap);
-        //int r = simfree(simdata, simmap, f->sim);
-        //y_log_message(Y_LOG_LEVEL_DEBUG, "simfree returned %i.", r);
+    y_log_message(Y_LOG_LEVEL_INFO, "Game pid %i exited, so closing bridge pid %i", f->game_pid, f->bridge_pid);
+    gameclosed(f);
+}
 
-        if(simds.auto_bridge == true)
-        {
-            y_log_message(Y_LOG_LEVEL_INFO, "Starting Bridge Polling Thread.");
-            uv_timer_start(&gamefindtimer, gamefindcallback, 1000, 1000);
-        }
-        else
+void bridgeexitcallback(uv_poll_t* handle, int status, int events)
+{
+    (void) status;
+    (void) events;
+    void* b = uv_handle_get_data((uv_handle_t*) handle);
+    LoopData* f = (LoopData*) b;
+
+    // the game is still up but nothing feeds its shared memory any more, so
+    // stop publishing now instead of leaving the last frame in SIMAPI.DAT
+    y_log_message(Y_LOG_LEVEL_WARNING, "Bridge pid %i exited while game pid %i is still running", f->bridge_pid, f->game_pid);
+    waitpid(f->bridge_pid, NULL, WNOHANG);
+    f->bridge_pid = 0;
+    pidwatch_stop(bridgewatch);
+    bridgewatch = NULL;
+    releaseloop(f, f->simdata, f->simmap);
+}
+
+// watches the game, and the bridge we started for it, through pidfds
+// returns 1 when that is not possible and bridgeclosetimer has to poll instead
+int startexitwatch(LoopData* f)
+{
+    gamewatch = pidwatch_start(f->game_pid, gameexitcallback, f);
+    if(gamewatch == NULL)
+    {
+        return 1;
+    }
+    if(f->bridge_pid > 0)
+    {
+        bridgewatch = pidwatch_start(f->bridge_pid, bridgeexitcallback, f);
+    }
+    return 0;
+}
+
+void procpollcallback(uv_poll_t* handle, int status, int events)
+{
+    (void) handle;
+    (void) status;
+    (void) events;
+    int flags = procwatch_drain(procfd);
+    if(flags & PROCWATCH_LOST)
+    {
+        y_log_message(Y_LOG_LEVEL_WARNING, "Lost the process event connector, polling for games instead");
+        uv_poll_stop(&procpoll);
+        uv_close((uv_handle_t*) &procpoll, NULL);
+        procwatch_close(procfd);
+        procfd = -1;
+        if(gamefinding == true)
         {
-            y_log_message(Y_LOG_LEVEL_INFO, "Starting Data Mapping Thread.");
-            uv_timer_start(&datachecktimer, datacheckcallback, 1000, 1000);
+            uv_timer_start(&gamefindtimer, gamefindcallback, PROCWATCH_SETTLE_MS, 1000);
         }
+        return;
+    }
+    if((flags & PROCWATCH_EXEC) && gamefinding == true && gamefindsettling == false)
+    {
+        // the first exec of a burst sets the scan off, the rest are folded into it
+        // without pushing it back, so a steady stream of execs cannot hold it off
+        gamefindsettling = true;
+        uv_timer_start(&gamefindtimer, gamefindcallback, PROCWATCH_SETTLE_MS, PROCWATCH_FALLBACK_MS);
+    }
+}
+
+void shmpollcallback(uv_poll_t* handle, int status, int events)
+{
+    (void) handle;
+    (void) status;
+    (void) events;
+    // only matters while datacheckcallback is looking for sim data, bring its next run forward
+    if(shmwatch_drain(shmfd) == true && uv_is_active((uv_handle_t*) &datachecktimer))
+    {
+        y_log_message(Y_LOG_LEVEL_DEBUG, "sim shared memory appeared, checking for data now");
+        uv_timer_start(&datachecktimer, datacheckcallback, SHMWATCH_SETTLE_MS, 1000);
+    }
+}
+
+void startgamefind()
+{
+    gamefinding = true;
+    gamefindsettling = false;
+    if(procfd != -1)
+    {
+        // one scan for a game that is already running, after that on exec and now and then
+        uv_timer_start(&gamefindtimer, gamefindcallback, 1000, PROCWATCH_FALLBACK_MS);
+    }
+    else
+    {
+        uv_timer_start(&gamefindtimer, gamefindcallback, 1000, 1000);
     }
 }
 
 void gamefindcallback(uv_timer_t* handle)
 {
+    gamefindsettling = false;
     void* b = uv_handle_get_data((uv_handle_t*) handle);
     LoopData* f = (LoopData*) b;
     SimdSettings simds = f->simds;
     GameCompatInfo* game_compat_info = f->game_compat_info;
 
 
+    if(procscan == NULL)
+    {
+        // every configured exe and every known sim, matched in one walk of /proc per tick
+        procscan = procscan_create();
+        if(procscan != NULL)
+        {
+            for(int i = 0; i < f->compat_info_size; i++)
+            {
+                game_compat_info[i].LaunchScan = procscan_add(procscan, game_compat_info[i].LaunchExe);
+                game_compat_info[i].LiveScan = procscan_add(procscan, game_compat_info[i].LiveExe);
+            }
+            procscan_sims = simapi_procscan_add_sims(procscan);
+        }
+    }
+
     int i = 0;
     int gamepid = -1;
     int sim = 0;
-    for(int i = 0; i < f->compat_info_size; i++)
+    int found = 0;
+    if(procscan != NULL)
     {
-        char* tmp_launch_exe = game_compat_info[i].LaunchExe;
-        gamepid = IsProcessRunning(tmp_launch_exe);
-        if(gamepid > 0)
-        {
-            sim = game_compat_info[i].GameId;
-            y_log_message(Y_LOG_LEVEL_INFO, "found a specified launch process for gameid %i running at pid %i.", sim, gamepid);
-            break;
-        }
+        uint64_t start = simapi_monotonic_ns();
+        found = procscan_run(procscan);
+        metrics_time(&metrics->procscan, simapi_monotonic_ns() - start);
     }
-    if(gamepid <= 0 && sim <= 0)
+    if(found > 0)
     {
-        i = -1;
-        SimInfo si;
-        sim = getSimExe(&si);
-        gamepid = si.pid;
+        for(int i = 0; i < f->compat_info_size; i++)
+        {
+            gamepid = procscan_pid(procscan, game_compat_info[i].LaunchScan);
+            if(gamepid <= 0)
+            {
+                gamepid = procscan_pid(procscan, game_compat_info[i].LiveScan);
+            }
+            if(gamepid > 0)
+            {
+                sim = game_compat_info[i].GameId;
+                y_log_message(Y_LOG_LEVEL_INFO, "found a specified launch process for gameid %i running at pid %i.", sim, gamepid);
+                break;
+            }
+        }
+        if(gamepid <= 0 && sim <= 0)
+        {
+            i = -1;
+            SimInfo si;
+            sim = simapi_procscan_sim(procscan, procscan_sims, &si);
+            gamepid = si.pid;
+        }
     }
 
 
     int err = 0;
     if(sim > 0)
     {
+        gamefinding = false;
         y_log_message(Y_LOG_LEVEL_INFO, "Detected simulator id %i, starting appropriate bridge if necessary.", sim);
 
 
@@ -620,7 +1296,10 @@ void gamefindcallback(uv_timer_t* handle)
                 }
                 if(process == -1)
                 {
-                    y_log_message(Y_LOG_LEVEL_DEBUG, "Could not fork a bridge process");
+                    // the timer is still running, the next scan finds the game again and retries
+                    y_log_message(Y_LOG_LEVEL_WARNING, "Could not fork a bridge process, will try again");
+                    f->bridge_pid = 0;
+                    gamefinding = true;
                 }
             }
             else
@@ -637,7 +1316,7 @@ void gamefindcallback(uv_timer_t* handle)
             uv_timer_stop(handle);
         }
 
-        if(err == 0)
+        if(err == 0 && gamefinding == false)
         {
             if(simds.notify == true)
             {
@@ -661,6 +1340,7 @@ void udpstart(LoopData* f, SimData* simdata, SimMap* simmap)
     if (appstate == 2)
     {
         simdatamap(simdata, NULL, simmap2, f->sim, true, NULL);
+        publishsegments(simdata, NULL, false);
     }
 }
 
@@ -677,7 +1357,8 @@ void datacheckcallback(uv_timer_t* handle)
     {
         SimInfo si = getSim(simdata, simmap, false, startudp, true);
         //TODO: move all this to a siminfo struct in loop_data
-        f->simstate = si.isSimOn;
+        // the mapping thread checks it every frame
+        __atomic_store_n(&f->simstate, si.isSimOn, __ATOMIC_RELAXED);
         f->sim = si.simulatorapi;
         f->use_udp = si.SimUsesUDP;
     }
@@ -686,6 +1367,9 @@ void datacheckcallback(uv_timer_t* handle)
         if ( appstate == 1 )
         {
             appstate++;
+            metrics_start(metrics, f->sim);
+            startrecording();
+            startcapture(f);
 
             //simdata->tyrediameter[0] = -1;
             //simdata->tyrediameter[1] = -1;
@@ -696,15 +1380,44 @@ void datacheckcallback(uv_timer_t* handle)
             {
                 y_log_message(Y_LOG_LEVEL_INFO, "using udp for this sim title");
                 udpstart(f, simdata, simmap);
-                uv_udp_recv_start(&recv_socket, on_alloc, on_udp_recv);
+                memset(&udpstats, 0, sizeof(udpstats));
+                if (simds.rt == true)
+                {
+                    uv_os_fd_t fd;
+                    uv_fileno((uv_handle_t*) &recv_socket, &fd);
+                    rtmap_start(fd);
+                }
+                else
+                {
+                    uv_udp_recv_start(&recv_socket, on_alloc, on_udp_recv);
+                }
+                if (simds.udp_stats == true)
+                {
+                    uv_timer_start(&udpstatstimer, udpstatscallback, UDP_STATS_INTERVAL_MS, UDP_STATS_INTERVAL_MS);
+                }
             }
             else
             {
-                uv_timer_start(&datamaptimer, shmdatamapcallback, 2000, 16);
+                if (simds.rt == true)
+                {
+                    y_log_message(Y_LOG_LEVEL_INFO, "mapping on the real-time thread");
+                    rtmap_start(-1);
+                }
+                else if (simds.source_driven == true && startsourcepoll(f) == 0)
+                {
+                    y_log_message(Y_LOG_LEVEL_INFO, "mapping on new sim frames, checking at %i hz", simds.pollrate);
+                }
+                else
+                {
+                    uv_timer_start(&datamaptimer, shmdatamapcallback, 2000, 16);
+                }
             }
             uv_timer_stop(handle);
-            // i can make this more frequent but i need to be conscious of resources, don't want to trash anyone's frame rates
-            uv_timer_start(&bridgeclosetimer, bridgeclosecallback, 5, 5000);
+            if(startexitwatch(f) != 0)
+            {
+                // i can make this more frequent but i need to be conscious of resources, don't want to trash anyone's frame rates
+                uv_timer_start(&bridgeclosetimer, bridgeclosecallback, 5, 5000);
+            }
         }
     }
 
@@ -725,8 +1438,8 @@ void cb(uv_poll_t* handle, int status, int events)
     {
         if(f->releasing == false)
         {
-            appstate--;
-            y_log_message(Y_LOG_LEVEL_INFO, "User requested stop appstate is now %i", appstate);
+            int state = __atomic_sub_fetch(&appstate, 1, __ATOMIC_RELAXED);
+            y_log_message(Y_LOG_LEVEL_INFO, "User requested stop appstate is now %i", state);
             fflush(stdout);
         }
     }
@@ -735,12 +1448,16 @@ void cb(uv_poll_t* handle, int status, int events)
     {
         y_log_message(Y_LOG_LEVEL_INFO, "simd is exiting...");
         uv_timer_stop(&datachecktimer);
+        stopsourcepoll();
         if (recv_socket_initialized)
         {
             uv_udp_recv_stop(&recv_socket);
         }
         uv_timer_stop(&bridgeclosetimer);
+        stopexitwatch();
         uv_timer_stop(&gamefindtimer);
+        gamefinding = false;
+        uv_timer_stop(&udpstatstimer);
         uv_poll_stop(handle);
     }
 }
@@ -827,7 +1544,7 @@ int main(int argc, char** argv)
     if(good_config == true)
     {
         compat_info_size = getNumberOfConfigs(simds.configfile);
-        game_compat_info = malloc(compat_info_size * sizeof(GameCompatInfo));
+        game_compat_info = calloc(compat_info_size, sizeof(GameCompatInfo));
 
         loadconfig(simds, compat_info_size, game_compat_info);
 
@@ -914,18 +1631,31 @@ int main(int argc, char** argv)
         }
     }
 
+    // before any of the shared memory segments exist, so giving up here leaves nothing behind
+    metrics = metrics_open();
+    if (metrics == NULL)
+    {
+        y_log_message(Y_LOG_LEVEL_ERROR, "Could not allocate the metrics block");
+        if (stdin_is_tty)
+        {
+            tcsetattr(0, TCSANOW, &canonicalmode);
+        }
+        goto cleanup_final;
+    }
+
     set_simapi_log_info(simapilib_loginfo);
     if(p->verbosity_count>0)
     {
         set_simapi_log_debug(simapilib_logdebug);
         set_simapi_log_trace(simapilib_logtrace);
     }
-
     simdata = malloc(sizeof(SimData));
     bzero(simdata, sizeof(SimData));
 
     simmap = createSimMap();
     simmap2 = createSimMap();
+    simapi_set_proximity(simmap, p->radarcars_count > 0 ? p->radarcars : PROXCARS,
+                         p->radarradius_count > 0 ? p->radarradius : SIMAPI_PROXIMITY_RADIUS);
 
     compatmemmap = false;
     if(simds.auto_memmap == true)
@@ -935,8 +1665,22 @@ int main(int argc, char** argv)
         opensimcompatmap(compatmap);
     }
 
-    opensimmap(simmap2);
-    if (simmap2->fd != -1)
+    int simmap2error = opensimmap(simmap2);
+    hotmap = createSimMap();
+    coldmap = createSimMap();
+    carsmap = createSimMap();
+    simapi_set_neighbours(carsmap, p->neighbourradius_count > 0 ? p->neighbourradius : SIMAPI_NEIGHBOUR_RADIUS);
+    if (opensimsegment(hotmap, SIMAPI_SEGMENT_HOT) != 0 || opensimsegment(coldmap, SIMAPI_SEGMENT_COLD) != 0
+            || opensimsegment(carsmap, SIMAPI_SEGMENT_CARS) != 0)
+    {
+        y_log_message(Y_LOG_LEVEL_ERROR, "Failed to open hot, cold and cars shared memory segments!");
+    }
+    ringmap = createSimMap();
+    if (simds.history > 0 && opensimring(ringmap, simds.history) != 0)
+    {
+        y_log_message(Y_LOG_LEVEL_ERROR, "Failed to open the shared memory history ring!");
+    }
+    if (simmap2error == 0)
     {
         y_log_message(Y_LOG_LEVEL_INFO, "Successfully opened universal shared memory (fd: %d)", simmap2->fd);
     }
@@ -947,6 +1691,7 @@ int main(int argc, char** argv)
 
     simdata->simapiversion = SIMAPI_VERSION;
     simdmap(simmap2, simdata);
+    publishsegments(simdata, NULL, true);
     y_log_message(Y_LOG_LEVEL_INFO, "SimApi Version: %i\n", simdata->simapiversion);
 
     baton = (LoopData*) malloc(sizeof(LoopData));
@@ -971,17 +1716,60 @@ int main(int argc, char** argv)
     uv_timer_init(uv_default_loop(), &bridgeclosetimer);
     uv_timer_init(uv_default_loop(), &datachecktimer);
     uv_timer_init(uv_default_loop(), &datamaptimer);
+    uv_timer_init(uv_default_loop(), &udpstatstimer);
+    uv_timer_init(uv_default_loop(), &metricstimer);
+    uv_timer_start(&metricstimer, metricscallback, SIMD_METRICS_REFRESH_MS, SIMD_METRICS_REFRESH_MS);
+    if (simds.metricssocket != NULL)
+    {
+        if (metrics_serve(metrics, uv_default_loop(), simds.metricssocket) == 0)
+        {
+            y_log_message(Y_LOG_LEVEL_INFO, "serving metrics on %s", simds.metricssocket);
+        }
+        else
+        {
+            y_log_message(Y_LOG_LEVEL_WARNING, "Could not serve metrics on %s", simds.metricssocket);
+        }
+    }
 
     uv_handle_set_data((uv_handle_t*) &gamefindtimer, (void*) baton);
     uv_handle_set_data((uv_handle_t*) &bridgeclosetimer, (void*) baton);
     uv_handle_set_data((uv_handle_t*) &datachecktimer, (void*) baton);
     uv_handle_set_data((uv_handle_t*) &datamaptimer, (void*) baton);
 
+    if (simds.rt == true)
+    {
+        uv_async_init(uv_default_loop(), &rtasync, rtmapcallback);
+        uv_handle_set_data((uv_handle_t*) &rtasync, (void*) baton);
+        if (rtmap_init(baton, &rtasync) != 0)
+        {
+            y_log_message(Y_LOG_LEVEL_ERROR, "Could not start the real-time mapping thread, mapping on the main loop");
+            simds.rt = false;
+            uv_close((uv_handle_t*) &rtasync, NULL);
+        }
+    }
+
     y_log_message(Y_LOG_LEVEL_INFO, "Searching for sim data... Press q to quit...\n");
+    shmfd = shmwatch_open();
+    if(shmfd != -1)
+    {
+        uv_poll_init(uv_default_loop(), &shmpoll, shmfd);
+        uv_poll_start(&shmpoll, UV_READABLE, shmpollcallback);
+    }
     if(simds.auto_bridge == true)
     {
+        procfd = procwatch_open();
+        if(procfd != -1)
+        {
+            uv_poll_init(uv_default_loop(), &procpoll, procfd);
+            uv_poll_start(&procpoll, UV_READABLE, procpollcallback);
+            y_log_message(Y_LOG_LEVEL_INFO, "Watching process events for games.");
+        }
+        else
+        {
+            y_log_message(Y_LOG_LEVEL_INFO, "Process event connector unavailable (needs CAP_NET_ADMIN), polling for games.");
+        }
         y_log_message(Y_LOG_LEVEL_INFO, "Starting Bridge Polling Thread.");
-        uv_timer_start(&gamefindtimer, gamefindcallback, 1000, 1000);
+        startgamefind();
     }
     else
     {
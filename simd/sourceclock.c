@@ -0,0 +1,37 @@
+#include "sourceclock.h"
+
+#include <time.h>
+
+uint64_t sourceclock_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+void sourceclock_reset(SourceClock* clock, uint64_t frame)
+{
+    clock->frame = frame;
+    clock->lastmap = 0;
+}
+
+bool sourceclock_due(SourceClock* clock, SimMap* simmap, SimulatorAPI sim, int maxrate, uint64_t now)
+{
+    bool idle = now - clock->lastmap >= (uint64_t) SOURCE_IDLE_REFRESH_MS * 1000000;
+
+    uint64_t frame = clock->frame;
+    bool newframe = simapi_source_frame(simmap, sim, &frame) == true && frame != clock->frame;
+    if (newframe == true && idle == false && maxrate > 0 && now - clock->lastmap < 1000000000 / (uint64_t) maxrate)
+    {
+        // over the rate cap, pick this frame up on a later tick
+        return false;
+    }
+    if (newframe == false && idle == false)
+    {
+        return false;
+    }
+
+    clock->frame = frame;
+    clock->lastmap = now;
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef _SOURCECLOCK_H
+#define _SOURCECLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <simmapper.h>
+
+// map anyway this often so a paused or closed sim is still noticed
+#define SOURCE_IDLE_REFRESH_MS 250
+
+// decides when a shared memory sim has a frame worth mapping, from its own
+// frame counter, the rate cap and the idle refresh
+typedef struct
+{
+    uint64_t frame;
+    uint64_t lastmap;
+}
+SourceClock;
+
+uint64_t sourceclock_now();
+void sourceclock_reset(SourceClock* clock, uint64_t frame);
+bool sourceclock_due(SourceClock* clock, SimMap* simmap, SimulatorAPI sim, int maxrate, uint64_t now);
+
+#endif
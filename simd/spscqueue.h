@@ -0,0 +1,51 @@
+#ifndef _SPSCQUEUE_H
+#define _SPSCQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// lock free single producer single consumer queue of small messages
+// used between the libuv control loop and the real-time mapping thread
+
+#define SPSC_QUEUE_SIZE 16 // must be a power of two
+
+typedef struct
+{
+    int type;
+    int arg;
+}
+SpscMessage;
+
+typedef struct
+{
+    SpscMessage messages[SPSC_QUEUE_SIZE];
+    uint32_t head __attribute__((aligned(64))); // only written by the consumer
+    uint32_t tail __attribute__((aligned(64))); // only written by the producer
+}
+SpscQueue;
+
+static inline bool spsc_push(SpscQueue* q, SpscMessage m)
+{
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    if (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == SPSC_QUEUE_SIZE)
+    {
+        return false;
+    }
+    q->messages[tail & (SPSC_QUEUE_SIZE - 1)] = m;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool spsc_pop(SpscQueue* q, SpscMessage* m)
+{
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+    *m = q->messages[head & (SPSC_QUEUE_SIZE - 1)];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "udphelper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/sock_diag.h>
+#include <yder.h>
+
+static char* slots[UDP_POOL_SLOTS];
+static bool inuse[UDP_POOL_SLOTS];
+static size_t slotsize = 0;
+
+// allocated once when the socket is set up and reused for every receive,
+// libuv hands a slot back before it asks for the next one
+void udppool_init(bool recvmmsg)
+{
+    if (slotsize > 0)
+    {
+        return;
+    }
+
+    slotsize = UDP_DGRAM_SIZE;
+    if (recvmmsg == true)
+    {
+        slotsize = UDP_DGRAM_SIZE * UDP_RECVMMSG_DGRAMS;
+    }
+    for (int i = 0; i < UDP_POOL_SLOTS; i++)
+    {
+        slots[i] = calloc(1, slotsize);
+        inuse[i] = false;
+    }
+}
+
+void udppool_free()
+{
+    for (int i = 0; i < UDP_POOL_SLOTS; i++)
+    {
+        free(slots[i]);
+        slots[i] = NULL;
+    }
+    slotsize = 0;
+}
+
+void udppool_alloc(uv_buf_t* buf)
+{
+    for (int i = 0; i < UDP_POOL_SLOTS; i++)
+    {
+        if (inuse[i] == false && slots[i] != NULL)
+        {
+            inuse[i] = true;
+            buf->base = slots[i];
+            buf->len = slotsize;
+            return;
+        }
+    }
+
+    // libuv reports UV_ENOBUFS to the receive callback
+    buf->base = NULL;
+    buf->len = 0;
+}
+
+void udppool_release(const char* base)
+{
+    for (int i = 0; i < UDP_POOL_SLOTS; i++)
+    {
+        if (slots[i] == base)
+        {
+            inuse[i] = false;
+            return;
+        }
+    }
+}
+
+void udpstats_packet(UdpStats* stats, ssize_t nread, const char* base, unsigned flags)
+{
+    if (nread < 0)
+    {
+        if (base == NULL)
+        {
+            UDPSTATS_ADD(stats->nobufs, 1);
+        }
+        UDPSTATS_ADD(stats->errors, 1);
+        return;
+    }
+
+    UDPSTATS_ADD(stats->packets, 1);
+    stats->inbatch++;
+    if (flags & UV_UDP_PARTIAL)
+    {
+        UDPSTATS_ADD(stats->truncated, 1);
+    }
+}
+
+void udpstats_batch(UdpStats* stats)
+{
+    if (stats->inbatch == 0)
+    {
+        return;
+    }
+
+    UDPSTATS_ADD(stats->batches, 1);
+    if (stats->inbatch > 1)
+    {
+        UDPSTATS_ADD(stats->bursts, 1);
+    }
+    if (stats->inbatch > stats->maxburst)
+    {
+        __atomic_store_n(&stats->maxburst, stats->inbatch, __ATOMIC_RELAXED);
+    }
+    stats->inbatch = 0;
+}
+
+// the kernel's count of datagrams it dropped for this socket
+void udpstats_drops(UdpStats* stats, uv_udp_t* handle)
+{
+    uv_os_fd_t fd;
+    if (uv_fileno((uv_handle_t*) handle, &fd) == 0)
+    {
+        uint32_t meminfo[SK_MEMINFO_VARS];
+        socklen_t len = sizeof(meminfo);
+        if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0 && len > SK_MEMINFO_DROPS * sizeof(uint32_t))
+        {
+            __atomic_store_n(&stats->drops, meminfo[SK_MEMINFO_DROPS], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void udpstats_log(UdpStats* stats, uv_udp_t* handle)
+{
+    udpstats_drops(stats, handle);
+
+    y_log_message(Y_LOG_LEVEL_INFO, "udp packets: %lu, batches: %lu, bursts: %lu, largest burst: %u, dropped: %u, truncated: %lu, errors: %lu, out of buffers: %lu",
+                  (unsigned long) UDPSTATS_GET(stats->packets), (unsigned long) UDPSTATS_GET(stats->batches), (unsigned long) UDPSTATS_GET(stats->bursts), UDPSTATS_GET(stats->maxburst),
+                  UDPSTATS_GET(stats->drops), (unsigned long) UDPSTATS_GET(stats->truncated), (unsigned long) UDPSTATS_GET(stats->errors), (unsigned long) UDPSTATS_GET(stats->nobufs));
+}
+
+// have the kernel stamp every datagram as it arrives, recvmsg then hands it back
+int udp_timestamps(int fd)
+{
+    int on = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+}
+
+// the kernel receive time of a datagram as CLOCK_MONOTONIC ns, 0 if it has none
+// the kernel stamps in CLOCK_REALTIME, so move it by the current offset between the clocks
+uint64_t udp_receive_time(struct msghdr* msg)
+{
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(msg); c != NULL; c = CMSG_NXTHDR(msg, c))
+    {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            struct timespec real;
+            struct timespec mono;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            clock_gettime(CLOCK_REALTIME, &real);
+            clock_gettime(CLOCK_MONOTONIC, &mono);
+
+            int64_t age = ((int64_t) (real.tv_sec - ts.tv_sec) * 1000000000) + (real.tv_nsec - ts.tv_nsec);
+            uint64_t now = ((uint64_t) mono.tv_sec * 1000000000) + mono.tv_nsec;
+            if (age < 0 || (uint64_t) age > now)
+            {
+                return 0;
+            }
+            return now - age;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef _UDPHELPER_H
+#define _UDPHELPER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <uv.h>
+
+// libuv splits a recvmmsg buffer into chunks of this size, one per datagram
+#define UDP_DGRAM_SIZE 65536
+#define UDP_RECVMMSG_DGRAMS 8
+#define UDP_POOL_SLOTS 2
+// mappers read whole packet structs, so clear this much past a short datagram
+#define UDP_ZERO_TAIL 2048
+// control buffer for one SO_TIMESTAMPNS receive timestamp
+#define UDP_CONTROL_SIZE 64
+
+typedef struct
+{
+    uint64_t packets;
+    uint64_t batches;
+    uint64_t bursts; // batches with more than one datagram
+    uint32_t maxburst;
+    uint32_t inbatch;
+    uint64_t truncated;
+    uint64_t errors;
+    uint64_t nobufs;
+    uint32_t drops; // dropped by the kernel because the socket buffer was full
+}
+UdpStats;
+
+// with --rt the mapping thread counts while the libuv loop logs, every field has
+// one writer and is stored whole, readers load them with UDPSTATS_GET()
+#define UDPSTATS_ADD(field, n) __atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+#define UDPSTATS_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+void udppool_init(bool recvmmsg);
+void udppool_free();
+void udppool_alloc(uv_buf_t* buf);
+void udppool_release(const char* base);
+
+void udpstats_packet(UdpStats* stats, ssize_t nread, const char* base, unsigned flags);
+void udpstats_batch(UdpStats* stats);
+void udpstats_drops(UdpStats* stats, uv_udp_t* handle);
+void udpstats_log(UdpStats* stats, uv_udp_t* handle);
+
+int udp_timestamps(int fd);
+uint64_t udp_receive_time(struct msghdr* msg);
+
+#endif
@@ -4,6 +4,8 @@
 #include "../simapi/simapi.h"
 #include "../simapi/simdata.h"
 
+#define SIMDATAMAP_SIZE    1172
+
 struct Map
 {
     const char* name;
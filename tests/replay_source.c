@@ -0,0 +1,94 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../simapi/simdata.h"
+#include "../simapi/simapi.h"
+#include "../simapi/simmapper.h"
+
+// runs a simd --capture file back through the mappers, as fast as it will go
+// or with -r at the pace it was captured
+
+volatile int running = 1;
+
+void signal_handler(int signum)
+{
+    (void) signum;
+    running = 0;
+}
+
+static double elapsed_ns(struct timespec* a, struct timespec* b)
+{
+    return ((b->tv_sec - a->tv_sec) * 1e9) + (b->tv_nsec - a->tv_nsec);
+}
+
+int main(int argc, char* argv[])
+{
+    bool realtime = false;
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0)
+        {
+            realtime = true;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (path == NULL)
+    {
+        printf("Usage: %s [-r] <capture.simsrc>\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+
+    SimulatorAPI simulator;
+    SimulatorEXE simexe;
+    SimMap* simmap = createSimMap();
+    SimSourceFile* f = simapi_replay_open(path, &simulator, &simexe);
+    if (f == NULL)
+    {
+        printf("Could not open %s as a sim source capture\n", path);
+        freesimmap(simmap, false);
+        return 1;
+    }
+    printf("Replaying %s, %s\n", path, simapi_gametofullstr(simexe));
+
+    SimData* simdata = calloc(1, sizeof(SimData));
+    unsigned long frames = 0;
+    int error = SIMAPI_ERROR_NONE;
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (running && (error = simapi_replay_frame(f, simdata, simmap, realtime)) == SIMAPI_ERROR_NONE)
+    {
+        frames++;
+        if (realtime == true)
+        {
+            printf("\r%8lu  status %u  rpm %5u  speed %3u km/h  gear %s  lap %u   ", frames, simdata->simstatus, simdata->rpms, simdata->velocity, simdata->gearc, simdata->lap);
+            fflush(stdout);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (error != SIMAPI_ERROR_NONE && error != SIMAPI_ERROR_NODATA)
+    {
+        printf("\nCapture is damaged after %lu frames\n", frames);
+    }
+    printf("\n%lu frames", frames);
+    if (realtime == false && frames > 0)
+    {
+        printf(", %.0f ns per frame", elapsed_ns(&start, &end) / frames);
+    }
+    printf("\n");
+
+    simapi_replay_close(f, simmap);
+    free(simdata);
+    freesimmap(simmap, false);
+    return error == SIMAPI_ERROR_UNKNOWN;
+}
@@ -0,0 +1,561 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../simapi/simdata.h"
+#include "../simapi/simapi.h"
+#include "../simapi/simmapper.h"
+#include "../simapi/simmap.h"
+#include "../include/outgauge.h"
+#include "../include/f12018.h"
+
+// times each mapper against synthetic, fully populated source images, one
+// frame at a time, so mapper changes can be compared and the rate simd can
+// sustain on a given machine estimated
+//
+// usage: simapi_bench [frames]
+
+#define BENCH_FRAMES_DEFAULT 20000
+#define BENCH_WARMUP 200
+#define BENCH_DGRAM_SIZE 65536
+// a field of cars spread around a 2km oval, close enough together that
+// simapi_set_proximity_data always has neighbours to sort
+#define BENCH_TRACK_RADIUS 320.0
+// the rF2 plugin writes scoring at ~5Hz against telemetry at ~50Hz
+#define BENCH_RF2_SCORING_EVERY 10
+
+typedef struct
+{
+    SimData* simdata;
+    SimMap* simmap;
+
+    struct rF2Telemetry* rf2telemetry;
+    struct rF2Scoring* rf2scoring;
+    struct SPageFilePhysics* acphysics;
+    struct SPageFileGraphic* acgraphic;
+    struct SPageFileStatic* acstatic;
+    struct SPageFileCrewChief* accrewchief;
+    struct pcars2APIStruct* pcars2;
+    struct scs2TelemetryMap_s* scs2;
+
+    char* dirt2;
+    char* rbr;
+    char* wf2;
+    char* outgauge;
+    char* f1[4];
+}
+Bench;
+
+typedef struct
+{
+    const char* name;
+    void (*prepare)(Bench* b, int frame);
+    void (*map)(Bench* b, int frame);
+}
+BenchCase;
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static int bench_cmp(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void bench_car(int i, int frame, double* x, double* y)
+{
+    double angle = ((2 * M_PI * i) / MAXCARS) * 0.1 + (frame * 0.001);
+    *x = cos(angle) * BENCH_TRACK_RADIUS + (i % 3);
+    *y = sin(angle) * BENCH_TRACK_RADIUS - (i % 2);
+}
+
+static void* bench_alloc(size_t size)
+{
+    void* p = calloc(1, size);
+    if (p == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+// rFactor 2, the plugin's buffers only have room for 64 vehicles
+static void prepare_rfactor2(Bench* b, int frame)
+{
+    struct rF2Telemetry* t = b->rf2telemetry;
+    struct rF2Scoring* s = b->rf2scoring;
+    int cars = sizeof(t->mVehicles) / sizeof(t->mVehicles[0]);
+
+    bool scoring = frame % BENCH_RF2_SCORING_EVERY == 0;
+
+    t->mNumVehicles = cars;
+    if (scoring == true)
+    {
+        s->mScoringInfo.mNumVehicles = cars;
+        s->mScoringInfo.mGamePhase = 5;
+        s->mScoringInfo.mCurrentET = frame / 60.0;
+    }
+    for (int i = 0; i < cars; i++)
+    {
+        double x;
+        double y;
+        bench_car(i, frame, &x, &y);
+
+        // reversed, telemetry and scoring need not list the cars in the same order
+        rF2VehicleTelemetry* vt = &t->mVehicles[cars - 1 - i];
+        vt->mID = i;
+        vt->mPos.x = x;
+        vt->mPos.z = y;
+        vt->mLocalVel.z = -50.0;
+        vt->mOri[0].x = 1.0;
+        vt->mOri[1].y = 1.0;
+        vt->mOri[2].z = 1.0;
+        vt->mEngineRPM = 6000 + (frame % 2000);
+        vt->mEngineMaxRPM = 9000;
+        vt->mGear = 1 + (frame / 100) % 6;
+        vt->mFuel = 60.0 - (frame * 0.001);
+        vt->mUnfilteredThrottle = (frame % 100) / 100.0;
+
+        if (scoring == false)
+        {
+            continue;
+        }
+        rF2VehicleScoring* vs = &s->mVehicles[i];
+        vs->mID = i;
+        vs->mControl = i == cars / 2 ? 0 : 2;
+        vs->mIsPlayer = i == cars / 2;
+        vs->mPlace = i + 1;
+        vs->mTotalLaps = frame / 5000;
+        vs->mLapDist = frame + (i * 30.0);
+        vs->mLastLapTime = 92.5 + i;
+        vs->mBestLapTime = 91.25 + i;
+        vs->mPitState = i % 8 == 0 ? 2 : 0;
+        vs->mPos.x = x;
+        vs->mPos.z = y;
+        snprintf(vs->mDriverName, sizeof(vs->mDriverName), "Driver Number %d", i);
+        snprintf(vs->mVehicleName, sizeof(vs->mVehicleName), "Formula Renault 3.5 #%d", i);
+    }
+    t->mVersionUpdateBegin = t->mVersionUpdateEnd = frame;
+    if (scoring == true)
+    {
+        s->mVersionUpdateBegin = s->mVersionUpdateEnd = frame / BENCH_RF2_SCORING_EVERY;
+    }
+}
+
+static void map_rfactor2(Bench* b, int frame)
+{
+    (void) frame;
+    map_rfactor2_data(b->simdata, b->simmap);
+}
+
+// Assetto Corsa, a full 64 car crew chief page
+static void prepare_assetto_corsa(Bench* b, int frame)
+{
+    struct SPageFilePhysics* p = b->acphysics;
+    struct SPageFileCrewChief* c = b->accrewchief;
+    int cars = sizeof(c->vehicle) / sizeof(c->vehicle[0]);
+
+    p->packetId = frame;
+    p->rpms = 6000 + (frame % 2000);
+    p->gear = 1 + (frame / 100) % 6;
+    p->speedKmh = 180.0f;
+    p->velocity[0] = 50.0f;
+    p->velocity[2] = 10.0f;
+    p->localVelocity.x = 50.0f;
+    p->localVelocity.z = 10.0f;
+    p->gas = (frame % 100) / 100.0f;
+    b->acgraphic->packetId = frame;
+    b->acgraphic->status = AC_LIVE;
+    b->acstatic->TrackSPlineLength = 2000.0f;
+    b->acstatic->maxRpm = 9000;
+
+    c->numVehicles = cars;
+    for (int i = 0; i < cars; i++)
+    {
+        double x;
+        double y;
+        bench_car(i, frame, &x, &y);
+
+        acsVehicleInfo* v = &c->vehicle[i];
+        v->carId = i;
+        v->worldPosition.x = x;
+        v->worldPosition.z = y;
+        v->speedMS = 50.0f;
+        v->lapCount = frame / 5000;
+        v->carLeaderboardPosition = i + 1;
+        v->lastLapTimeMS = 92500 + i;
+        v->bestLapMS = 91250 + i;
+        v->spLineLength = fmod((frame + (i * 30.0)) / 2000.0, 1.0);
+        v->isCarInPitline = i % 8 == 0;
+        snprintf(v->driverName, sizeof(v->driverName), "Driver Number %d", i);
+        snprintf(v->carModel, sizeof(v->carModel), "ks_mazda_mx5_cup_%d", i);
+    }
+}
+
+static void map_assetto_corsa(Bench* b, int frame)
+{
+    (void) frame;
+    map_assetto_corsa_data(b->simdata, b->simmap, SIMULATOREXE_ASSETTO_CORSA);
+}
+
+// Project Cars 2, all 64 participants
+static void prepare_project_cars2(Bench* b, int frame)
+{
+    struct pcars2APIStruct* p = b->pcars2;
+    int cars = STORED_PARTICIPANTS_MAX;
+
+    p->mSequenceNumber = frame * 2;
+    p->mGameState = 2;
+    p->mSpeed = 50.0f;
+    p->mRpm = 6000 + (frame % 2000);
+    p->mMaxRPM = 9000;
+    p->mGear = 1 + (frame / 100) % 6;
+    p->mThrottle = (frame % 100) / 100.0f;
+    p->mLocalVelocity[0] = 1.0f;
+    p->mLocalVelocity[2] = 50.0f;
+    p->mWorldVelocity[0] = 1.0f;
+    p->mWorldVelocity[2] = 50.0f;
+    p->mViewedParticipantIndex = 0;
+    p->mNumParticipants = cars;
+    for (int i = 0; i < cars; i++)
+    {
+        double x;
+        double y;
+        bench_car(i, frame, &x, &y);
+
+        ParticipantInfo* v = &p->mParticipantInfo[i];
+        v->mIsActive = true;
+        v->mWorldPosition[0] = x;
+        v->mWorldPosition[2] = y;
+        v->mCurrentLapDistance = frame + (i * 30.0f);
+        v->mRacePosition = i + 1;
+        v->mCurrentLap = 1 + frame / 5000;
+        snprintf(v->mName, sizeof(v->mName), "Driver Number %d", i);
+        snprintf(p->mCarNames[i], sizeof(p->mCarNames[i]), "Formula Rookie #%d", i);
+        p->mSpeeds[i] = 50.0f;
+        p->mLastLapTimes[i] = 92.5f + i;
+        p->mFastestLapTimes[i] = 91.25f + i;
+        p->mPitModes[i] = i % 8 == 0;
+    }
+}
+
+static void map_project_cars2(Bench* b, int frame)
+{
+    (void) frame;
+    map_project_cars2_data(b->simdata, b->simmap, false, NULL);
+}
+
+static void prepare_trucks(Bench* b, int frame)
+{
+    b->scs2->truck_f.speed = 25.0f;
+    b->scs2->truck_f.engineRpm = 1200 + (frame % 600);
+    b->scs2->truck_i.gear = 1 + (frame / 100) % 12;
+}
+
+static void map_trucks(Bench* b, int frame)
+{
+    (void) frame;
+    map_trucks_data(b->simdata, b->simmap);
+}
+
+static void prepare_dirt_rally_2(Bench* b, int frame)
+{
+    // every field of the extradata=3 packet is a float
+    float* f = (float*) b->dirt2;
+    for (int i = 0; i < 66; i++)
+    {
+        f[i] = (i + 1) * 0.5f + (frame % 10);
+    }
+}
+
+static void map_dirt_rally_2(Bench* b, int frame)
+{
+    (void) frame;
+    map_dirt_rally_2_data(b->simdata, b->simmap, b->dirt2);
+}
+
+static void prepare_richard_burns_rally(Bench* b, int frame)
+{
+    RBR_TelemetryData* p = (RBR_TelemetryData*) b->rbr;
+    p->totalSteps_ = frame;
+    p->car_.speed_ = 120.0f;
+    p->car_.engine_.rpm_ = 6000 + (frame % 2000);
+    p->control_.gear_ = 1 + (frame / 100) % 6;
+    p->control_.throttle_ = (frame % 100) / 100.0f;
+}
+
+static void map_richard_burns_rally(Bench* b, int frame)
+{
+    (void) frame;
+    map_richard_burns_rally_data(b->simdata, b->simmap, b->rbr);
+}
+
+static void prepare_wreckfest2(Bench* b, int frame)
+{
+    WF2_PacketMain* p = (WF2_PacketMain*) b->wf2;
+    p->header.signature = 1869769584;
+    p->header.packetType = WF2_PACKET_TYPE_MAIN;
+    p->header.sessionTime = frame * 16;
+    p->carPlayer.engine.rpm = 6000 + (frame % 2000);
+    p->carPlayer.engine.rpmMax = 9000;
+    p->carPlayer.driveline.gear = 1 + (frame / 100) % 6;
+    p->carPlayer.driveline.speed = 50.0f;
+    p->carPlayer.input.throttle = (frame % 100) / 100.0f;
+}
+
+static void map_wreckfest2(Bench* b, int frame)
+{
+    (void) frame;
+    map_wreckfest2_data(b->simdata, b->simmap, b->wf2);
+}
+
+static void prepare_outgauge(Bench* b, int frame)
+{
+    struct outgauge* p = (struct outgauge*) b->outgauge;
+    p->rpm = 6000 + (frame % 2000);
+    p->speed = 50.0f;
+    p->gear = 1 + (frame / 100) % 6;
+    snprintf(p->car, sizeof(p->car), "XRT");
+}
+
+static void map_outgauge(Bench* b, int frame)
+{
+    (void) frame;
+    map_outgauge_outsim_data(b->simdata, b->simmap, SIMULATOREXE_LIVE_FOR_SPEED, b->outgauge);
+}
+
+// F1 2018 sends a different packet each time, cycle through the ones the mapper reads
+static void prepare_f1_2018(Bench* b, int frame)
+{
+    static const uint8_t ids[4] = { PACKET_ID_CAR_TELEMETRY, PACKET_ID_PARTICIPANTS, PACKET_ID_SESSION, PACKET_ID_LAP_DATA };
+    for (int k = 0; k < 4; k++)
+    {
+        struct PacketHeader* h = (struct PacketHeader*) b->f1[k];
+        h->m_packetFormat = 2018;
+        h->m_packetId = ids[k];
+        h->m_frameIdentifier = frame;
+        h->m_playerCarIndex = 3;
+    }
+
+    struct PacketCarTelemetryData* t = (struct PacketCarTelemetryData*) (b->f1[0] + sizeof(struct PacketHeader));
+    struct PacketParticipantsData* p = (struct PacketParticipantsData*) (b->f1[1] + sizeof(struct PacketHeader));
+    struct PacketLapData* l = (struct PacketLapData*) (b->f1[3] + sizeof(struct PacketHeader));
+    p->m_numCars = 20;
+    for (int i = 0; i < 20; i++)
+    {
+        t->m_carTelemetryData[i].m_speed = 180;
+        t->m_carTelemetryData[i].m_engineRPM = 10000 + (frame % 2000);
+        t->m_carTelemetryData[i].m_gear = 1 + (frame / 100) % 8;
+        p->m_participants[i].m_driverId = i;
+        p->m_participants[i].m_teamId = i % 10;
+        l->m_lapData[i].m_lastLapTime = 92.5f + i;
+        l->m_lapData[i].m_currentLapTime = frame / 60.0f;
+    }
+}
+
+static void map_f1_2018(Bench* b, int frame)
+{
+    map_f1_2018_data(b->simdata, b->simmap, b->f1[frame % 4]);
+}
+
+// a full SimData car table with the player in the middle of the pack
+static void prepare_proximity(Bench* b, int frame)
+{
+    SimData* s = b->simdata;
+    for (int i = 0; i < MAXCARS; i++)
+    {
+        bench_car(i, frame, &s->cars[i].xpos, &s->cars[i].ypos);
+    }
+    s->worldposx = s->cars[0].xpos;
+    s->worldposy = s->cars[0].ypos;
+    s->Xvelocity = 2.0;
+    s->Yvelocity = 50.0;
+    s->worldXvelocity = -sin(frame * 0.001) * 50.0;
+    s->worldYvelocity = cos(frame * 0.001) * 50.0;
+}
+
+static void map_proximity(Bench* b, int frame)
+{
+    (void) frame;
+    simapi_set_proximity_data(b->simdata, b->simmap, MAXCARS, 0, 1);
+}
+
+static const BenchCase cases[] =
+{
+    { "rfactor2", prepare_rfactor2, map_rfactor2 },
+    { "assetto_corsa", prepare_assetto_corsa, map_assetto_corsa },
+    { "project_cars2", prepare_project_cars2, map_project_cars2 },
+    { "trucks", prepare_trucks, map_trucks },
+    { "dirt_rally_2", prepare_dirt_rally_2, map_dirt_rally_2 },
+    { "richard_burns_rally", prepare_richard_burns_rally, map_richard_burns_rally },
+    { "wreckfest2", prepare_wreckfest2, map_wreckfest2 },
+    { "outgauge", prepare_outgauge, map_outgauge },
+    { "f1_2018", prepare_f1_2018, map_f1_2018 },
+    { "proximity", prepare_proximity, map_proximity },
+};
+
+static void bench_setup(Bench* b)
+{
+    b->simdata = bench_alloc(sizeof(SimData));
+    b->simmap = createSimMap();
+
+    b->rf2telemetry = bench_alloc(sizeof(struct rF2Telemetry));
+    b->rf2scoring = bench_alloc(sizeof(struct rF2Scoring));
+    b->simmap->rf2.telemetry_map_addr = b->rf2telemetry;
+    b->simmap->rf2.scoring_map_addr = b->rf2scoring;
+    b->simmap->rf2.has_telemetry = true;
+    b->simmap->rf2.has_scoring = true;
+
+    b->acphysics = bench_alloc(sizeof(struct SPageFilePhysics));
+    b->acgraphic = bench_alloc(sizeof(struct SPageFileGraphic));
+    b->acstatic = bench_alloc(sizeof(struct SPageFileStatic));
+    b->accrewchief = bench_alloc(sizeof(struct SPageFileCrewChief));
+    b->simmap->ac.physics_map_addr = b->acphysics;
+    b->simmap->ac.graphic_map_addr = b->acgraphic;
+    b->simmap->ac.static_map_addr = b->acstatic;
+    b->simmap->ac.crewchief_map_addr = b->accrewchief;
+    b->simmap->ac.has_physics = true;
+    b->simmap->ac.has_graphic = true;
+    b->simmap->ac.has_static = true;
+    b->simmap->ac.has_crewchief = true;
+
+    b->pcars2 = bench_alloc(sizeof(struct pcars2APIStruct));
+    b->simmap->pcars2.telemetry_map_addr = b->pcars2;
+    b->simmap->pcars2.has_telemetry = true;
+
+    b->scs2 = bench_alloc(sizeof(struct scs2TelemetryMap_s));
+    b->simmap->scs2.telemetry_map_addr = b->scs2;
+    b->simmap->scs2.has_telemetry = true;
+
+    // datagrams sit in a zeroed receive sized buffer, as they do in simd
+    b->dirt2 = bench_alloc(BENCH_DGRAM_SIZE);
+    b->rbr = bench_alloc(BENCH_DGRAM_SIZE);
+    b->wf2 = bench_alloc(BENCH_DGRAM_SIZE);
+    b->outgauge = bench_alloc(BENCH_DGRAM_SIZE);
+    for (int k = 0; k < 4; k++)
+    {
+        b->f1[k] = bench_alloc(BENCH_DGRAM_SIZE);
+    }
+}
+
+// publishes ACC frames through simdatamap() into a SIMAPI.DAT in memory, the
+// regions the AC mapper does not mark must still reach readers, like simon
+// and simexe that getSim() sets while no source page moves
+static int bench_check_publish(Bench* b)
+{
+    SimMap* pub = createSimMap();
+    pub->addr = bench_alloc(SIMAPI_MEM_SIZE);
+    pub->size = SIMAPI_MEM_SIZE;
+    pub->sync = (SimDataSync*) ((char*) pub->addr + SIMAPI_SYNC_OFFSET);
+    pub->shadow = bench_alloc(sizeof(SimData));
+    pub->shadow_valid = false;
+
+    memset(b->simdata, 0, sizeof(SimData));
+    b->simdata->simexe = SIMULATOREXE_ASSETTO_CORSA_COMPETIZIONE;
+    prepare_assetto_corsa(b, 1);
+    simdatamap(b->simdata, b->simmap, pub, SIMULATORAPI_ASSETTO_CORSA, false, NULL);
+
+    // the session starts with the pages as they were, then the pages move
+    b->simdata->simon = true;
+    b->simdata->simapi = SIMULATORAPI_ASSETTO_CORSA;
+    int failed = 0;
+    for (int frame = 1; frame <= 2; frame++)
+    {
+        prepare_assetto_corsa(b, frame);
+        simdatamap(b->simdata, b->simmap, pub, SIMULATORAPI_ASSETTO_CORSA, false, NULL);
+        if (memcmp(pub->addr, b->simdata, sizeof(SimData)) != 0)
+        {
+            size_t off = 0;
+            while (((char*) pub->addr)[off] == ((char*) b->simdata)[off])
+            {
+                off++;
+            }
+            printf("SIMAPI.DAT differs from SimData at byte %zu after ACC frame %d\n", off, frame);
+            failed = 1;
+        }
+    }
+
+    free(pub->shadow);
+    free(pub->addr);
+    free(pub);
+    return failed;
+}
+
+static void bench_run(Bench* b, const BenchCase* c, int frames, uint64_t* samples)
+{
+    memset(b->simdata, 0, sizeof(SimData));
+    for (int i = 0; i < BENCH_WARMUP; i++)
+    {
+        c->prepare(b, i);
+        c->map(b, i);
+    }
+
+    uint64_t total = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        c->prepare(b, BENCH_WARMUP + i);
+        uint64_t start = bench_now();
+        c->map(b, BENCH_WARMUP + i);
+        samples[i] = bench_now() - start;
+        total += samples[i];
+    }
+    qsort(samples, frames, sizeof(uint64_t), bench_cmp);
+
+    uint64_t p99 = samples[(frames * 99) / 100];
+    printf("%-20s %9.0f %9lu %9lu %9lu %9lu %12.0f\n", c->name, (double) total / frames,
+           (unsigned long) samples[frames / 2], (unsigned long) samples[(frames * 90) / 100],
+           (unsigned long) p99, (unsigned long) samples[frames - 1], p99 > 0 ? 1e9 / p99 : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = BENCH_FRAMES_DEFAULT;
+    if (argc > 1)
+    {
+        frames = atoi(argv[1]);
+    }
+    if (frames < 100)
+    {
+        printf("Usage: %s [frames, at least 100]\n", argv[0]);
+        return 1;
+    }
+
+    Bench b;
+    bench_setup(&b);
+    uint64_t* samples = bench_alloc(frames * sizeof(uint64_t));
+
+    // some mappers print debug output to stderr, keep it out of the results
+    // but still pay for it in the timings, only once setup could say it ran out of memory
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull != -1)
+    {
+        dup2(devnull, STDERR_FILENO);
+        close(devnull);
+    }
+
+    if (bench_check_publish(&b) != 0)
+    {
+        return 1;
+    }
+
+    printf("%d frames per mapper, times in ns per frame\n\n", frames);
+    printf("%-20s %9s %9s %9s %9s %9s %12s\n", "mapper", "mean", "p50", "p90", "p99", "max", "Hz at p99");
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++)
+    {
+        bench_run(&b, &cases[k], frames, samples);
+    }
+
+    free(samples);
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <unistd.h>
 
 #include "../simapi/simdata.h"
+#include "../simapi/simmapper.h"
 
 volatile int running = 1;
 
@@ -22,29 +23,20 @@ void print_lap_time(const char* label, LapTime lt)
 
 int main(int argc, char* argv[])
 {
-    int fd;
-    SimData *simdata;
+    SimData snapshot = {0};
+    SimData *simdata = &snapshot;
 
     // Set up signal handler for clean exit
     signal(SIGINT, signal_handler);
 
     printf("Opening SIMAPI.DAT shared memory...\n");
 
-    // Open the shared memory file
-    fd = open("/dev/shm/SIMAPI.DAT", O_RDONLY);
-    if (fd == -1)
-    {
-        perror("Failed to open shared memory");
-        return 1;
-    }
-
-    // Map the shared memory
-    simdata =
-        (SimData *)mmap(NULL, sizeof(SimData), PROT_READ, MAP_SHARED, fd, 0);
-    if (simdata == MAP_FAILED)
+    // Open and map the shared memory file
+    SimMap* simmap = createSimMap();
+    if (siminit(simdata, simmap, SIMULATORAPI_SIMAPI_TEST) != 0)
     {
         perror("Failed to map shared memory");
-        close(fd);
+        freesimmap(simmap, false);
         return 1;
     }
 
@@ -53,6 +45,13 @@ int main(int argc, char* argv[])
 
     while (running)
     {
+        // copy out a consistent frame instead of reading the live mapping,
+        // on BUSY or NODATA the copy is stale or was never filled, try again later
+        if (simapi_read_simdata(simmap, simdata) != SIMAPI_ERROR_NONE)
+        {
+            usleep(100000);
+            continue;
+        }
         if (simdata->simon == 1 && simdata->simstatus >= SIMAPI_STATUS_MENU)
         {
             printf("\033[H\033[J"); // Clear screen and move cursor to home
@@ -132,8 +131,7 @@ int main(int argc, char* argv[])
     printf("\n\nExiting...\n");
 
     // Clean up
-    munmap(simdata, sizeof(SimData));
-    close(fd);
+    freesimmap(simmap, false);
 
     return 0;
 }